@@ -1,16 +1,41 @@
 #pragma once
 
 #include <Arduino.h>
+#include <etl/circular_buffer.h>
 #include <etl/queue.h>
-#include <message_buffer.h>
 
+#include "LineArena.hpp"
+
+/// What a counter keeps of a sent line, to trace device errors back to it
+struct LineRecord {
+	LineOrigin origin;
+	uint16_t   hash; ///< lineHash() of the text as sent
+	uint8_t    lane;
+};
+
+/// FNV-1a of the line text, folded to 16 bits
+inline uint16_t lineHash (const char* line, size_t len)
+{
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < len; i++)
+		hash = (hash ^ static_cast< uint8_t > (line[ i ])) * 16777619u;
+	return static_cast< uint16_t > ((hash >> 16) ^ (hash & 0xFFFF));
+}
+
+/**
+ * Tracks lines sent to the device that are not acknowledged yet.
+ *
+ * Lines are referenced by their LineArena handles. A counter either retains
+ * the handle (and the slot stays allocated until the line is popped) or keeps
+ * only the line length, in which case peek() and pop() return kNoLine.
+ */
 class Counter {
 public:
 	virtual void clear () = 0;
 
 	virtual bool canPush (size_t len) const = 0;
 
-	virtual bool push (char* msg, size_t len) = 0;
+	virtual bool push (LineHandle line, size_t len) = 0;
 
 	virtual size_t size () const = 0;
 
@@ -20,155 +45,220 @@ public:
 
 	virtual size_t getFreeBytes () const = 0;
 
-	virtual size_t peek (char*& msg) = 0;
+	virtual LineHandle peek () const = 0;
 
-	virtual void pop () = 0;
+	virtual LineHandle pop () = 0;
 };
 
-template <
-    uint16_t LEN_LINES    = 16,
-    uint16_t LEN_BYTES    = 128,
-    uint8_t  MAX_LINE_LEN = 100 >
+/**
+ * Sent queue that retains line handles.
+ *
+ * LEN_BYTES bounds the bytes that may sit in the device RX buffer. Lines that
+ * the device reports as moved from RX into its command buffer can be marked
+ * as drained, and their bytes are no longer counted against that bound. The
+ * line window may be narrowed at runtime below LEN_LINES.
+ *
+ * Lines may carry the number they were sent with, so that lines the device
+ * asks for again can be found and sent once more.
+ */
+template < uint16_t LEN_LINES = 16, uint16_t LEN_BYTES = 128 >
 class SizedQueue : public Counter {
 public:
 	SizedQueue ()
 	{
-		freeLines = LEN_LINES;
-		freeBytes = LEN_BYTES;
-		buf       = xMessageBufferCreateStatic (LEN_BYTES, data, &bufStruct);
+		clear ();
 	}
 
 	void clear () override
 	{
-		xMessageBufferReset (buf);
-		havePeekedLine = false;
-		peekedLineLen  = 0;
-		freeLines      = LEN_LINES;
-		freeBytes      = LEN_BYTES;
+		queue.clear ();
+		rxBytes    = 0;
+		totalBytes = 0;
+		drained    = 0;
+		lineLimit  = LEN_LINES;
 	}
 
 	bool canPush (size_t len) const override
 	{
-		if (len > MAX_LINE_LEN)
-			len = MAX_LINE_LEN;
-		return freeBytes > len + 1 && freeLines > 0;
+		return LEN_BYTES - rxBytes > len + 1 && queue.size () < lineLimit;
 	}
 
-	bool push (char* msg, size_t len) override
+	bool push (LineHandle line, size_t len) override
+	{
+		return push (line, len, 0);
+	}
+
+	bool push (LineHandle line, size_t len, uint32_t number)
 	{
 		if (!canPush (len))
 			return false;
-		if (len > MAX_LINE_LEN)
-			len = MAX_LINE_LEN;
-		assert (xMessageBufferSend (buf, msg, len, 0));
-		freeLines--;
-		freeBytes -= len + 1;
+		queue.push (SentLine{line, static_cast< uint8_t > (len), number});
+		rxBytes += len + 1;
+		totalBytes += len + 1;
 		return true;
 	}
 
 	inline size_t size () const override
 	{
-		return LEN_LINES - freeLines;
+		return queue.size ();
 	}
 
 	inline size_t getFreeLines () const override
 	{
-		return freeLines;
+		return queue.size () < lineLimit ? lineLimit - queue.size () : 0;
 	}
 
 	inline size_t bytes () const override
 	{
-		return LEN_BYTES - freeBytes;
+		return totalBytes;
 	}
 
 	inline size_t getFreeBytes () const override
 	{
-		return freeBytes;
+		return LEN_BYTES - rxBytes;
 	}
 
-	size_t peek (char*& msg) override
+	LineHandle peek () const override
 	{
-		if (size () == 0)
-			return 0;
-		if (!havePeekedLine)
-		{
-			loadLineFromBuf ();
-		}
-		// len = peekedLineLen;
-		msg = peekedLine;
-		return peekedLineLen;
+		if (queue.empty ())
+			return kNoLine;
+		return queue.front ().line;
 	}
 
-	void pop () override
+	LineHandle pop () override
 	{
-		if (size () == 0)
-			return;
-		freeLines++;
-		if (havePeekedLine)
-		{
-			freeBytes += peekedLineLen + 1;
-			havePeekedLine = false;
-			peekedLineLen  = 0;
-		}
+		if (queue.empty ())
+			return kNoLine;
+		SentLine v = queue.front ();
+		queue.pop ();
+		totalBytes -= v.len + 1;
+		if (drained > 0)
+			drained--;
 		else
-		{
-			size_t r = xMessageBufferReceive (buf, peekedLine, MAX_LINE_LEN, 0);
-			freeBytes += r + 1;
-		}
+			rxBytes -= v.len + 1;
+		return v.line;
 	}
 
-private:
-	MessageBufferHandle_t buf;
-	StaticMessageBuffer_t bufStruct;
-	uint8_t               data[ LEN_BYTES ];
+	/// Marks the oldest n lines as no longer occupying device RX buffer
+	void markDrained (size_t n)
+	{
+		if (n > queue.size ())
+			n = queue.size ();
+		for (; drained < n; drained++)
+			rxBytes -= queue[ drained ].len + 1;
+	}
+
+	void setLineLimit (size_t lines)
+	{
+		lineLimit = lines < LEN_LINES ? lines : LEN_LINES;
+	}
 
-	size_t freeLines;
-	size_t freeBytes;
-	char   peekedLine[ MAX_LINE_LEN + 1 ];
-	size_t peekedLineLen;
-	bool   havePeekedLine;
+	inline size_t getLineLimit () const
+	{
+		return lineLimit;
+	}
+
+	/// Position of the line sent with the number, size() if it is not kept
+	size_t find (uint32_t number) const
+	{
+		size_t i = 0;
+		while (i < queue.size () && queue[ i ].number != number)
+			i++;
+		return i;
+	}
+
+	inline LineHandle lineAt (size_t i) const
+	{
+		return queue[ i ].line;
+	}
 
-	bool loadLineFromBuf ()
+	inline uint32_t numberAt (size_t i) const
 	{
-		peekedLineLen =
-		    xMessageBufferReceive (buf, peekedLine, MAX_LINE_LEN, 0);
-		havePeekedLine              = peekedLineLen > 0;
-		peekedLine[ peekedLineLen ] = 0;
-		return havePeekedLine;
+		return queue[ i ].number;
 	}
+
+private:
+	struct SentLine {
+		LineHandle line;
+		uint8_t    len;
+		uint32_t   number;
+	};
+
+	etl::circular_buffer< SentLine, LEN_LINES > queue;
+
+	size_t rxBytes;    ///< Bytes that may still be in device RX buffer
+	size_t totalBytes; ///< Bytes of all unacknowledged lines
+	size_t drained;    ///< Number of oldest lines moved out of RX buffer
+	size_t lineLimit;
 };
 
-template <
-    uint16_t LEN_LINES  = 16,
-    uint16_t LEN_BYTES  = 128,
-    uint8_t  SUFFIX_LEN = 1 >
+/**
+ * Character counting for devices that only need line lengths.
+ *
+ * The capacity is set at runtime since the device RX buffer size is usually
+ * known only after asking the device; MAX_LINES only sizes the storage.
+ * Besides the length a small record of each line is kept, the device may
+ * answer the oldest one with an error.
+ */
+template < uint16_t MAX_LINES = 128, uint8_t SUFFIX_LEN = 1 >
 class SimpleCounter : public Counter {
 public:
-	SimpleCounter ()
+	static const size_t kMaxLines = MAX_LINES;
+
+	SimpleCounter (size_t lines, size_t bytes)
+	{
+		setCapacity (lines, bytes);
+	}
+
+	/// Lines already in flight stay accounted for
+	void setCapacity (size_t lines, size_t bytes)
+	{
+		lineCapacity = lines < MAX_LINES ? lines : MAX_LINES;
+		byteCapacity = bytes;
+	}
+
+	inline size_t getLineCapacity () const
+	{
+		return lineCapacity;
+	}
+
+	inline size_t getByteCapacity () const
 	{
-		freeBytes = LEN_BYTES;
+		return byteCapacity;
 	}
 
 	void clear () override
 	{
 		queue.clear ();
-		freeBytes = LEN_BYTES;
+		usedBytes = 0;
 	}
 
 	bool canPush (size_t len) const override
 	{
-		return queue.size () < LEN_LINES && freeBytes >= len + SUFFIX_LEN;
+		return queue.size () < lineCapacity &&
+		    usedBytes + len + SUFFIX_LEN <= byteCapacity;
+	}
+
+	bool push (LineHandle line, size_t len) override
+	{
+		return push (len, LineRecord{});
 	}
 
-	bool push (char* msg, size_t len) override
+	bool push (size_t len, const LineRecord& record)
 	{
 		if (!canPush (len))
 			return false;
-		queue.push (len);
-		freeBytes -= len + SUFFIX_LEN;
+		queue.push (SentLine{record, static_cast< uint8_t > (len)});
+		usedBytes += len + SUFFIX_LEN;
 		return true;
 	}
 
+	/// Record of the oldest line, the next response is for; null if none
+	const LineRecord* front () const
+	{
+		return queue.empty () ? nullptr : &queue.front ().record;
+	}
+
 	inline size_t size () const override
 	{
 		return queue.size ();
@@ -176,36 +266,43 @@ public:
 
 	inline size_t getFreeLines () const override
 	{
-		return LEN_LINES - queue.size ();
+		return queue.size () < lineCapacity ? lineCapacity - queue.size () : 0;
 	}
 
 	inline size_t bytes () const override
 	{
-		return LEN_BYTES - freeBytes;
+		return usedBytes;
 	}
 
 	inline size_t getFreeBytes () const override
 	{
-		return freeBytes;
+		return usedBytes < byteCapacity ? byteCapacity - usedBytes : 0;
 	}
 
-	size_t peek (char*& msg) override
+	LineHandle peek () const override
 	{
-		if (queue.size () == 0)
-			return 0;
-		return queue.front ();
+		return kNoLine;
 	}
 
-	void pop () override
+	LineHandle pop () override
 	{
 		if (queue.size () == 0)
-			return;
-		size_t v = queue.front ();
+			return kNoLine;
+		size_t v = queue.front ().len;
 		queue.pop ();
-		freeBytes += v + SUFFIX_LEN;
+		usedBytes -= v + SUFFIX_LEN;
+		return kNoLine;
 	}
 
 private:
-	etl::queue< size_t, LEN_LINES > queue;
-	size_t                          freeBytes;
+	struct SentLine {
+		LineRecord record;
+		uint8_t    len;
+	};
+
+	etl::queue< SentLine, MAX_LINES > queue;
+
+	size_t lineCapacity;
+	size_t byteCapacity;
+	size_t usedBytes = 0;
 };
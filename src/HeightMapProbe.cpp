@@ -0,0 +1,332 @@
+#include "HeightMapProbe.hpp"
+
+
+#include <math.h>
+#include <stdio.h>
+
+#include <SD.h>
+
+#include <etl/algorithm.h>
+
+#include "Job.h"
+
+
+namespace {
+	template < typename TValue >
+	void ReadSetting (
+	    JsonObjectConst i_config, const char* i_key, TValue& io_value) noexcept
+	{
+		if (auto const value_conf = i_config[ i_key ]; !value_conf.isNull ())
+		{
+			io_value = value_conf.as< TValue > ();
+		}
+	}
+} // namespace
+
+
+void HeightMapProbe::ApplyConfig (JsonObjectConst i_config) noexcept
+{
+	if (i_config.isNull ())
+	{
+		return;
+	}
+
+	ReadSetting (i_config, "x0", default_grid_.x0);
+	ReadSetting (i_config, "y0", default_grid_.y0);
+	ReadSetting (i_config, "width", default_grid_.width);
+	ReadSetting (i_config, "height", default_grid_.height);
+	ReadSetting (i_config, "columns", default_grid_.columns);
+	ReadSetting (i_config, "rows", default_grid_.rows);
+	ReadSetting (i_config, "clearance", default_grid_.clearance);
+	ReadSetting (i_config, "depth", default_grid_.depth);
+	ReadSetting (i_config, "feed", default_grid_.feed);
+
+	if (auto const file_conf = i_config[ "file" ]; !file_conf.isNull ())
+	{
+		file_path_ = file_conf.as< const char* > ();
+	}
+}
+
+
+bool HeightMapProbe::Start (const ProbeGrid& i_grid)
+{
+	auto const device = GCodeDevice::getDevice ();
+
+	if ((State::kProbing == state_.load ()) || (nullptr == device) ||
+	    (device->getType () != "grbl") || device->isInPanic () ||
+	    Job::getJob ()->isRunning ())
+	{
+		return false;
+	}
+
+	auto const grbl = static_cast< GrblDevice* > (device);
+
+	if (GrblState::kIdle != grbl->Status ().state)
+	{
+		return false;
+	}
+
+	if ((0 == i_grid.columns) || (0 == i_grid.rows) ||
+	    (size_t{i_grid.columns} * i_grid.rows > kMaxPoints) ||
+	    (i_grid.width < 0) || (i_grid.height < 0) || (i_grid.feed <= 0) ||
+	    (i_grid.depth >= i_grid.clearance))
+	{
+		return false;
+	}
+
+	grid_        = i_grid;
+	point_count_ = size_t{i_grid.columns} * i_grid.rows;
+	next_line_   = 0;
+	reference_z_ = 0;
+	fail_reason_ = "";
+
+	GrblProbeResult result;
+
+	seen_probe_count_ = grbl->ProbeResult (result);
+
+	etl::fill_n (heights_, point_count_, kNoHeight);
+
+	probed_.store (0);
+	cancel_requested_.store (false);
+	state_.store (State::kProbing);
+
+	return true;
+}
+
+
+void HeightMapProbe::Loop ()
+{
+	if (State::kProbing != state_.load ())
+	{
+		return;
+	}
+
+	auto const device = static_cast< GrblDevice* > (GCodeDevice::getDevice ());
+
+	if (nullptr == device)
+	{
+		Fail ("No device");
+
+		return;
+	}
+
+	if (cancel_requested_.exchange (false))
+	{
+		// The queued probe moves must not run either
+		device->reset ();
+
+		Fail ("Cancelled");
+
+		return;
+	}
+
+	// No contact raises ALARM:5, a bad line an error
+	if (device->isInPanic ())
+	{
+		Fail ("Probe failed");
+
+		return;
+	}
+
+	GrblProbeResult result;
+
+	if (auto const count = device->ProbeResult (result);
+	    count != seen_probe_count_)
+	{
+		if (1 != count - seen_probe_count_)
+		{
+			Fail ("Probe reply lost");
+
+			return;
+		}
+
+		seen_probe_count_ = count;
+
+		if (!result.success)
+		{
+			Fail ("No contact");
+
+			return;
+		}
+
+		StoreHeight (probed_.load (), result.machine_position.z);
+
+		probed_.store (probed_.load () + 1);
+	}
+
+	SendLines (*device);
+
+	if ((probed_.load () == point_count_) && (next_line_ == LineCount ()))
+	{
+		if (!Save ())
+		{
+			Fail ("SD write failed");
+
+			return;
+		}
+
+		state_.store (State::kDone);
+	}
+}
+
+
+const char* HeightMapProbe::StateName () const noexcept
+{
+	switch (state_.load ())
+	{
+	case State::kIdle:
+		return "idle";
+
+	case State::kProbing:
+		return "probing";
+
+	case State::kDone:
+		return "done";
+
+	case State::kFailed:
+		return "failed";
+	}
+
+	return "?";
+}
+
+
+size_t HeightMapProbe::FormatLine (
+    size_t i_line, char* o_line, size_t i_size) const
+{
+	if (0 == i_line)
+	{
+		return snprintf (o_line, i_size, "G21 G90");
+	}
+
+	if (LineCount () - 1 == i_line)
+	{
+		return snprintf (o_line, i_size, "G0 Z%.3f", grid_.clearance);
+	}
+
+	auto const point = (i_line - 1) / kLinesPerPoint;
+	auto const index = GridIndex (point);
+	auto const row   = index / grid_.columns;
+	auto const col   = index % grid_.columns;
+
+	switch ((i_line - 1) % kLinesPerPoint)
+	{
+	case 0:
+		return snprintf (o_line, i_size, "G0 Z%.3f", grid_.clearance);
+
+	case 1:
+		return snprintf (
+		    o_line,
+		    i_size,
+		    "G0 X%.3f Y%.3f",
+		    grid_.x0 + col * StepX (),
+		    grid_.y0 + row * StepY ());
+
+	default:
+		return snprintf (
+		    o_line, i_size, "G38.2 Z%.3f F%.1f", grid_.depth, grid_.feed);
+	}
+}
+
+
+size_t HeightMapProbe::GridIndex (size_t i_point) const noexcept
+{
+	auto const row = i_point / grid_.columns;
+	auto       col = i_point % grid_.columns;
+
+	if (row & 1)
+	{
+		col = grid_.columns - 1 - col;
+	}
+
+	return row * grid_.columns + col;
+}
+
+
+void HeightMapProbe::SendLines (GrblDevice& io_device)
+{
+	char line[ 48 ];
+
+	while (next_line_ < LineCount ())
+	{
+		// The units line goes with the first point, the retract with the last
+		auto const point = etl::min (
+		    next_line_ > 0 ? (next_line_ - 1) / kLinesPerPoint : size_t{0},
+		    point_count_ - 1);
+
+		if (point > probed_.load () + kPointsAhead)
+		{
+			return;
+		}
+
+		auto const length = FormatLine (next_line_, line, sizeof (line));
+
+		if (!io_device.canSchedule (length, GCodeDevice::LANE_JOB) ||
+		    (GCodeDevice::SubmitResult::OK !=
+		     io_device.submitCommand (line, length, GCodeDevice::LANE_JOB)))
+		{
+			return;
+		}
+
+		++next_line_;
+	}
+}
+
+
+void HeightMapProbe::StoreHeight (size_t i_point, float i_machine_z) noexcept
+{
+	auto const z = static_cast< int32_t > (lroundf (i_machine_z * 1000));
+
+	if (0 == i_point)
+	{
+		reference_z_ = z;
+	}
+
+	// kNoHeight stays out of range
+	heights_[ GridIndex (i_point) ] = static_cast< int16_t > (
+	    etl::clamp (z - reference_z_, int32_t{-INT16_MAX}, int32_t{INT16_MAX}));
+}
+
+
+bool HeightMapProbe::Save () const
+{
+	HeightMapHeader header{};
+
+	memcpy (header.magic, "HMAP", sizeof (header.magic));
+
+	header.version     = 1;
+	header.columns     = grid_.columns;
+	header.rows        = grid_.rows;
+	header.x0          = grid_.x0;
+	header.y0          = grid_.y0;
+	header.step_x      = StepX ();
+	header.step_y      = StepY ();
+	header.reference_z = reference_z_;
+
+	File file = SD.open (file_path_, FILE_WRITE);
+
+	if (!file)
+	{
+		return false;
+	}
+
+	auto const heights_size = point_count_ * sizeof (heights_[ 0 ]);
+
+	auto const written =
+	    file.write (
+	        reinterpret_cast< const uint8_t* > (&header), sizeof (header)) +
+	    file.write (
+	        reinterpret_cast< const uint8_t* > (heights_), heights_size);
+
+	file.close ();
+
+	return sizeof (header) + heights_size == written;
+}
+
+
+void HeightMapProbe::Fail (const char* i_reason) noexcept
+{
+	fail_reason_ = i_reason;
+
+	state_.store (State::kFailed);
+}
@@ -0,0 +1,185 @@
+#ifndef SRC_HEIGHTMAPPROBE_HPP
+#define SRC_HEIGHTMAPPROBE_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include <etl/atomic.h>
+
+#include "devices/GrblDevice.hpp"
+
+
+/// Points to probe, in millimetres and the active work coordinates
+struct ProbeGrid {
+	float    x0{0}; ///< First corner
+	float    y0{0};
+	float    width{50};
+	float    height{50};
+	uint16_t columns{5};
+	uint16_t rows{5};
+	float    clearance{2}; ///< Z to move at between points
+	float    depth{-2};    ///< Lowest Z a probe move goes to
+	float    feed{50};
+};
+
+
+/**
+ * Start of a height map file. The heights follow as rows * columns
+ * int16_t, row by row from y0, each in µm above the first point probed,
+ * HeightMapProbe::kNoHeight where none was taken. All little endian.
+ */
+struct HeightMapHeader {
+	char     magic[ 4 ]; ///< "HMAP"
+	uint8_t  version;
+	uint8_t  flags; ///< 0, for future use
+	uint16_t columns;
+	uint16_t rows;
+	uint16_t reserved;
+	float    x0;
+	float    y0;
+	float    step_x;
+	float    step_y;
+	int32_t  reference_z; ///< Machine Z of the first point, µm
+};
+
+static_assert (sizeof (HeightMapHeader) == 32, "Padding in HeightMapHeader");
+
+
+/**
+ * Probes a grid with G38.2 and saves the heights to SD.
+ *
+ * The lines of the next points are queued while the current one is probed,
+ * so Grbl reads them from its receive buffer as soon as the probe stops
+ * instead of waiting for the [PRB:] reply to come back first.
+ */
+class HeightMapProbe {
+public:
+	enum class State : uint8_t {
+		kIdle,
+		kProbing,
+		kDone,
+		kFailed,
+	};
+
+	static size_t constexpr kMaxPoints = 1024;
+
+	static int16_t constexpr kNoHeight = INT16_MIN;
+
+	/// Reads the default grid and the file path
+	void ApplyConfig (JsonObjectConst i_config) noexcept;
+
+	const ProbeGrid& DefaultGrid () const noexcept
+	{
+		return default_grid_;
+	}
+
+	/**
+	 * Starts probing, from any task.
+	 *
+	 * @return false if probing already, the device is not an idle Grbl, a
+	 *         job is running or the grid is invalid
+	 */
+	bool Start (const ProbeGrid& i_grid);
+
+	/// Stops the machine, from any task
+	void Cancel () noexcept
+	{
+		cancel_requested_.store (true);
+	}
+
+	/// Sends the lines and takes the replies, from the main loop
+	void Loop ();
+
+	State GetState () const noexcept
+	{
+		return state_.load ();
+	}
+
+	const char* StateName () const noexcept;
+
+	/// Why the last run failed, empty if it did not
+	const char* FailReason () const noexcept
+	{
+		return fail_reason_;
+	}
+
+	size_t PointCount () const noexcept
+	{
+		return point_count_;
+	}
+
+	size_t ProbedCount () const noexcept
+	{
+		return probed_.load ();
+	}
+
+	const String& FilePath () const noexcept
+	{
+		return file_path_;
+	}
+
+
+private:
+	/// Points whose lines are queued ahead of the one being probed
+	static size_t constexpr kPointsAhead = 2;
+
+	/// Clearance move, move over the point, probe move
+	static size_t constexpr kLinesPerPoint = 3;
+
+	ProbeGrid default_grid_;
+	ProbeGrid grid_;
+
+	String file_path_{"/heightmap.bin"};
+
+	etl::atomic< State > state_{State::kIdle};
+	etl::atomic< bool >  cancel_requested_{false};
+
+	size_t                point_count_{0};
+	etl::atomic< size_t > probed_{0};
+
+	/// Units mode first, kLinesPerPoint per point, final retract last
+	size_t next_line_{0};
+
+	uint32_t seen_probe_count_{0};
+	int32_t  reference_z_{0}; ///< µm
+
+	const char* fail_reason_{""};
+
+	int16_t heights_[ kMaxPoints ];
+
+	size_t LineCount () const noexcept
+	{
+		return 2 + point_count_ * kLinesPerPoint;
+	}
+
+	float StepX () const noexcept
+	{
+		return grid_.columns > 1 ? grid_.width / (grid_.columns - 1) : 0.0f;
+	}
+
+	float StepY () const noexcept
+	{
+		return grid_.rows > 1 ? grid_.height / (grid_.rows - 1) : 0.0f;
+	}
+
+	/// Writes line i of the sequence, returns its length
+	size_t FormatLine (size_t i_line, char* o_line, size_t i_size) const;
+
+	/// Grid index of the n-th point probed, rows are probed back and forth
+	size_t GridIndex (size_t i_point) const noexcept;
+
+	void SendLines (GrblDevice& io_device);
+
+	void StoreHeight (size_t i_point, float i_machine_z) noexcept;
+
+	bool Save () const;
+
+	void Fail (const char* i_reason) noexcept;
+};
+
+
+#endif // SRC_HEIGHTMAPPROBE_HPP
@@ -5,7 +5,9 @@
 #include <SD.h>
 #include <WiFi.h>
 
+#include "HeightMapProbe.hpp"
 #include "Job.h"
+#include "devices/GrblDevice.hpp"
 
 #define API_VERSION "0.1"
 #define SKETCH_VERSION "0.0.1"
@@ -13,6 +15,7 @@
 WebServer* WebServer::inst = nullptr;
 
 extern HardwareSerial PrinterSerial; // dirty hack
+extern HeightMapProbe height_map_probe;
 
 void WebServer::config (JsonObjectConst cfg)
 {
@@ -134,6 +137,138 @@ inline String stringify (bool value)
 	return value ? "true" : "false";
 }
 
+// Answers a refused command submission; okMessage is sent for an accepted
+// one unless it is null. Back-pressure is reported as 503 so clients retry.
+bool sendSubmitResult (
+    AsyncWebServerRequest*    req,
+    GCodeDevice::SubmitResult result,
+    const char*               okMessage)
+{
+	switch (result)
+	{
+	case GCodeDevice::SubmitResult::OK:
+		if (okMessage != nullptr)
+			req->send (200, "text/plain", okMessage);
+		return true;
+	case GCodeDevice::SubmitResult::PANIC:
+		req->send (409, "text/plain", "device in panic");
+		return false;
+	case GCodeDevice::SubmitResult::EMPTY:
+		req->send (400, "text/plain", "empty command");
+		return false;
+	default:
+	{
+		AsyncWebServerResponse* response =
+		    req->beginResponse (503, "text/plain", "queue full");
+		response->addHeader ("Retry-After", "1");
+		req->send (response);
+		return false;
+	}
+	}
+}
+
+// {"feed": {"value": 100, "target": 120}, ...}, target 0 when none is pending
+String getOverridesJson (GrblDevice* dev)
+{
+	String json = "{";
+	for (size_t i = 0; i < kGrblOverrideCount; i++)
+	{
+		auto const kind = static_cast< GrblOverride > (i);
+
+		json += String (i == 0 ? "\r\n" : ",\r\n") + "  \"" +
+		    GrblOverrideName (kind) +
+		    "\": { \"value\": " + String (dev->OverrideValue (kind)) +
+		    ", \"target\": " + String (dev->OverrideTarget (kind)) + " }";
+	}
+
+	auto const stats = dev->GetOverrideStats ();
+
+	json += ",\r\n"
+	        "  \"bytesSent\": " +
+	    String (stats.bytes_sent) +
+	    ",\r\n"
+	    "  \"mismatches\": " +
+	    String (stats.mismatches) +
+	    ",\r\n"
+	    "  \"failures\": " +
+	    String (stats.failures) + "\r\n}";
+	return json;
+}
+
+// {"count": 3, "errors": [{"kind": "error", "code": 20, ...}, ...]}, newest
+// first; line fields are null when no line was waiting for the answer
+String getErrorsJson (GrblDevice* dev)
+{
+	GrblErrorRecord records[ GrblErrorLog::kCapacity ];
+
+	auto const& log   = dev->ErrorLog ();
+	auto const  count = log.Count ();
+	auto const  held  = log.Snapshot (records);
+
+	String json = "{\r\n"
+	              "  \"count\": " +
+	    String (count) + ",\r\n  \"errors\": [";
+	for (size_t i = 0; i < held; i++)
+	{
+		auto const& record = records[ held - 1 - i ];
+
+		json += String (i == 0 ? "\r\n" : ",\r\n") +
+		    "    { \"ageMs\": " + String (millis () - record.time) +
+		    ", \"kind\": \"" + (record.alarm ? "alarm" : "error") +
+		    "\", \"code\": " + String (record.code) + ", \"message\": \"" +
+		    record.Message () + "\"";
+		if (record.has_line)
+			json += String (", \"lane\": \"") +
+			    GCodeDevice::getLaneName (
+			        static_cast< GCodeDevice::Lane > (record.lane)) +
+			    "\", \"line\": " + String (record.line_number) +
+			    ", \"offset\": " + String (record.file_offset) +
+			    ", \"hash\": " + String (record.line_hash) + " }";
+		else
+			json += ", \"lane\": null, \"line\": null, \"offset\": null, "
+			        "\"hash\": null }";
+	}
+	json += "\r\n  ]\r\n}";
+	return json;
+}
+
+// Samples oldest first, as JSON [actual, target] pairs in 0.1 °C with null
+// for missing readings, or as int16 little endian pairs
+void writeTemperatureHistory (
+    Print&                    out,
+    const TemperatureHistory& history,
+    TemperatureHistory::Tier  tier,
+    bool                      binary)
+{
+	size_t size = history.Size (tier);
+
+	if (!binary)
+		out.print (
+		    "{ \"periodMs\": " +
+		    String (TemperatureHistory::PeriodMs (tier)) + ", \"samples\": [");
+	for (size_t age = size; age-- > 0;)
+	{
+		TemperatureSample sample = history.Get (tier, age);
+		if (binary)
+		{
+			const uint8_t bytes[] = {
+			    (uint8_t)sample.actual,
+			    (uint8_t)(sample.actual >> 8),
+			    (uint8_t)sample.target,
+			    (uint8_t)(sample.target >> 8)};
+			out.write (bytes, sizeof (bytes));
+		}
+		else if (sample.IsMissing ())
+			out.print (age + 1 == size ? "null" : ", null");
+		else
+			out.print (
+			    String (age + 1 == size ? "[" : ", [") +
+			    String (sample.actual) + ", " + String (sample.target) + "]");
+	}
+	if (!binary)
+		out.print ("] }");
+}
+
 String getStateText (Job* job = nullptr, MarlinDevice* dev = nullptr)
 {
 	if (job == nullptr)
@@ -346,9 +481,11 @@ void WebServer::registerOptoPrintApi ()
 		int32_t printTime = 0, printTimeLeft = INT32_MAX;
 		if (job->isRunning ())
 		{
-			printTime     = job->getPrintDuration () / 1000;
-			float p       = job->getCompletion ();
-			printTimeLeft = (p > 0) ? printTime / p * (1 - p) : INT32_MAX;
+			printTime = job->getPrintDuration () / 1000;
+			// The same estimate as the M73 R sent to the printer
+			uint32_t left = job->getRemainingTime ();
+			if (left != Job::UNKNOWN_TIME)
+				printTimeLeft = left / 1000;
 		}
 
 		request->send (
@@ -515,7 +652,16 @@ void WebServer::registerOptoPrintApi ()
 		        }
 		        JsonArray commands = doc[ "commands" ].as< JsonArray > ();
 		        for (JsonVariant command : commands)
-			        dev->scheduleCommand (String (command.as< String > ()));
+		        {
+			        String cmd = command.as< String > ();
+			        // Stop at the first refused line, the rest would be sent
+			        // out of order
+			        if (!sendSubmitResult (
+			                req,
+			                dev->submitCommand (cmd.c_str (), cmd.length ()),
+			                nullptr))
+				        return;
+		        }
 		        req->send (204, "text/plain", "");
 	        });
 	server.addHandler (printerCommandHandler);
@@ -860,6 +1006,55 @@ void WebServer::registerWebBrowser ()
 		req->send (200, "text/plain", "ok");
 	});
 
+	// POST /api2/resume?line=1234 starts the stopped job at a file line, the
+	// main loop does it; GET /api2/resume tells how it went
+	server.on ("/api2/resume", HTTP_POST, [] (AsyncWebServerRequest* req) {
+		if (!req->hasParam ("line"))
+		{
+			req->send (400, "text/plain", "no line parameter");
+			return;
+		}
+		long line = req->getParam ("line")->value ().toInt ();
+		if (line <= 0)
+		{
+			req->send (400, "text/plain", "invalid line");
+			return;
+		}
+		if (GCodeDevice::getDevice () == nullptr)
+		{
+			req->send (409, "text/plain", "no device");
+			return;
+		}
+		Job* job = Job::getJob ();
+		if (job->isRunning () ||
+		    job->getResumeStatus () == Job::RESUME_PENDING)
+		{
+			req->send (409, "text/plain", "Job running");
+			return;
+		}
+		job->requestResume (line);
+		req->send (202, "text/plain", "resume requested");
+	});
+
+	// The lines sent before the file once the resume started
+	server.on ("/api2/resume", HTTP_GET, [] (AsyncWebServerRequest* req) {
+		switch (Job::getJob ()->getResumeStatus ())
+		{
+		case Job::RESUME_NONE:
+			req->send (404, "text/plain", "no resume requested");
+			break;
+		case Job::RESUME_PENDING:
+			req->send (202, "text/plain", "pending");
+			break;
+		case Job::RESUME_STARTED:
+			req->send (200, "text/plain", Job::getJob ()->getResumePreamble ());
+			break;
+		case Job::RESUME_FAILED:
+			req->send (400, "text/plain", "File or line not found");
+			break;
+		}
+	});
+
 	server.on ("/api2/cmd", HTTP_GET, [] (AsyncWebServerRequest* req) {
 		if (!req->hasParam ("gcode"))
 		{
@@ -876,13 +1071,353 @@ void WebServer::registerWebBrowser ()
 			req->send (409, "text/plain", "no device");
 			return;
 		}
-		if (dev->scheduleCommand (gcode))
+		sendSubmitResult (
+		    req, dev->submitCommand (gcode.c_str (), gcode.length ()), "ok");
+	});
+
+	server.on ("/api2/overrides", HTTP_GET, [] (AsyncWebServerRequest* req) {
+		GCodeDevice* dev = GCodeDevice::getDevice ();
+		if (dev == nullptr || dev->getType () != "grbl")
 		{
-			req->send (200, "text/plain", "ok");
+			req->send (409, "text/plain", "no grbl device");
+			return;
 		}
-		else
+		req->send (
+		    200,
+		    "application/json",
+		    getOverridesJson (static_cast< GrblDevice* > (dev)));
+	});
+
+	// POST /api2/overrides?feed=120&rapid=50&spindle=90, any subset, percent
+	server.on ("/api2/overrides", HTTP_POST, [] (AsyncWebServerRequest* req) {
+		GCodeDevice* dev = GCodeDevice::getDevice ();
+		if (dev == nullptr || dev->getType () != "grbl")
+		{
+			req->send (409, "text/plain", "no grbl device");
+			return;
+		}
+		auto grbl = static_cast< GrblDevice* > (dev);
+
+		// Checked first, nothing is changed by a partly bad request
+		long percents[ kGrblOverrideCount ] = {};
+		bool any                            = false;
+		for (size_t i = 0; i < kGrblOverrideCount; i++)
+		{
+			auto const  kind = static_cast< GrblOverride > (i);
+			const char* name = GrblOverrideName (kind);
+			if (!req->hasParam (name))
+				continue;
+
+			percents[ i ] = req->getParam (name)->value ().toInt ();
+			if (percents[ i ] <= 0)
+			{
+				req->send (400, "text/plain", "invalid percentage");
+				return;
+			}
+			any = true;
+		}
+		if (!any)
+		{
+			req->send (400, "text/plain", "no feed, rapid or spindle");
+			return;
+		}
+		for (size_t i = 0; i < kGrblOverrideCount; i++)
+		{
+			if (percents[ i ] > 0)
+				grbl->SetOverride (
+				    static_cast< GrblOverride > (i), percents[ i ]);
+		}
+		req->send (200, "application/json", getOverridesJson (grbl));
+	});
+
+	server.on ("/api2/errors", HTTP_GET, [] (AsyncWebServerRequest* req) {
+		GCodeDevice* dev = GCodeDevice::getDevice ();
+		if (dev == nullptr || dev->getType () != "grbl")
+		{
+			req->send (409, "text/plain", "no grbl device");
+			return;
+		}
+		req->send (
+		    200,
+		    "application/json",
+		    getErrorsJson (static_cast< GrblDevice* > (dev)));
+	});
+
+	// GET /api2/temperatures?heater=T0&tier=fine&format=json, B for the bed,
+	// coarse for the last hour, bin for binary
+	server.on ("/api2/temperatures", HTTP_GET, [] (AsyncWebServerRequest* req) {
+		GCodeDevice* dev = GCodeDevice::getDevice ();
+		if (dev == nullptr || dev->getType () != "marlin")
+		{
+			req->send (409, "text/plain", "no marlin device");
+			return;
+		}
+		MarlinDevice* marlin = static_cast< MarlinDevice* > (dev);
+
+		auto const param = [ req ] (const char* name, const char* def) {
+			return req->hasParam (name) ? req->getParam (name)->value ()
+			                            : String (def);
+		};
+		String heater = param ("heater", "T0");
+
+		const TemperatureHistory* history = nullptr;
+		if (heater == "B")
+			history = &marlin->getBedHistory ();
+		else if (
+		    heater.length () == 2 && heater[ 0 ] == 'T' &&
+		    isDigit (heater[ 1 ]) &&
+		    heater[ 1 ] - '0' < marlin->getExtruderCount ())
+			history = &marlin->getExtruderHistory (heater[ 1 ] - '0');
+		if (history == nullptr)
+		{
+			req->send (400, "text/plain", "unknown heater");
+			return;
+		}
+
+		TemperatureHistory::Tier tier = param ("tier", "fine") == "coarse"
+		    ? TemperatureHistory::Tier::kCoarse
+		    : TemperatureHistory::Tier::kFine;
+		bool binary = param ("format", "json") == "bin";
+
+		AsyncResponseStream* response = req->beginResponseStream (
+		    binary ? "application/octet-stream" : "application/json");
+		writeTemperatureHistory (*response, *history, tier, binary);
+		req->send (response);
+	});
+
+	// {"state": "probing", "points": 25, "probed": 7, "file": "/heightmap.bin",
+	// "error": ""}, the map is at /fs<file> once done
+	server.on ("/api2/probe", HTTP_GET, [] (AsyncWebServerRequest* req) {
+		req->send (
+		    200,
+		    "application/json",
+		    String ("{ \"state\": \"") + height_map_probe.StateName () +
+		        "\", \"points\": " + String (height_map_probe.PointCount ()) +
+		        ", \"probed\": " + String (height_map_probe.ProbedCount ()) +
+		        ", \"file\": \"" + height_map_probe.FilePath () +
+		        "\", \"error\": \"" + height_map_probe.FailReason () +
+		        "\" }");
+	});
+
+	// POST /api2/probe?x0=0&y0=0&width=80&height=50&columns=9&rows=6
+	// &clearance=2&depth=-2&feed=50, missing ones from the config
+	server.on ("/api2/probe", HTTP_POST, [] (AsyncWebServerRequest* req) {
+		ProbeGrid grid = height_map_probe.DefaultGrid ();
+
+		auto const readFloat = [ req ] (const char* name, float& value) {
+			if (req->hasParam (name))
+				value = req->getParam (name)->value ().toFloat ();
+		};
+		auto const readCount = [ req ] (const char* name, uint16_t& value) {
+			if (req->hasParam (name))
+				value = req->getParam (name)->value ().toInt ();
+		};
+		readFloat ("x0", grid.x0);
+		readFloat ("y0", grid.y0);
+		readFloat ("width", grid.width);
+		readFloat ("height", grid.height);
+		readCount ("columns", grid.columns);
+		readCount ("rows", grid.rows);
+		readFloat ("clearance", grid.clearance);
+		readFloat ("depth", grid.depth);
+		readFloat ("feed", grid.feed);
+
+		if (!height_map_probe.Start (grid))
+		{
+			req->send (
+			    409, "text/plain", "busy, not an idle grbl, or invalid grid");
+			return;
+		}
+		req->send (200, "text/plain", "ok");
+	});
+
+	server.on ("/api2/probe", HTTP_DELETE, [] (AsyncWebServerRequest* req) {
+		height_map_probe.Cancel ();
+		req->send (200, "text/plain", "ok");
+	});
+
+	server.on ("/api2/stats", HTTP_GET, [] (AsyncWebServerRequest* req) {
+		GCodeDevice* dev = GCodeDevice::getDevice ();
+		if (dev == nullptr)
+		{
+			req->send (409, "text/plain", "no device");
+			return;
+		}
+
+		auto const load = dev->getTaskLoadStats ();
+
+		auto const submit = dev->getSubmitStats ();
+
+		auto const total_ms = load.busyMs + load.idleMs;
+
+		String message =
+		    "{\r\n"
+		    "  \"deviceTask\": {\r\n"
+		    "    \"busyMs\": " +
+		    String (load.busyMs) +
+		    ",\r\n"
+		    "    \"idleMs\": " +
+		    String (load.idleMs) +
+		    ",\r\n"
+		    "    \"busyRatio\": " +
+		    String (total_ms ? 1.0f * load.busyMs / total_ms : 0.0f, 4) +
+		    ",\r\n"
+		    "    \"wakeups\": { \"rx\": " +
+		    String (load.rxWakeups) +
+		    ", \"command\": " +
+		    String (load.commandWakeups) +
+		    ", \"timer\": " +
+		    String (load.timerWakeups) +
+		    " }\r\n"
+		    "  },\r\n"
+		    "  \"responses\": {\r\n"
+		    "    \"overflowedLines\": " +
+		    String (dev->getOverflowedResponses ()) +
+		    "\r\n"
+		    "  },\r\n"
+		    "  \"submissions\": {\r\n"
+		    "    \"accepted\": " +
+		    String (submit.accepted) +
+		    ",\r\n"
+		    "    \"refusedPanic\": " +
+		    String (submit.panic) +
+		    ",\r\n"
+		    "    \"refusedNoSlots\": " +
+		    String (submit.noSlots) +
+		    ",\r\n"
+		    "    \"refusedLaneFull\": " +
+		    String (submit.laneFull) +
+		    "\r\n"
+		    "  },\r\n"
+		    "  \"lanes\": {";
+
+		for (int i = 0; i < GCodeDevice::LANE_COUNT; i++)
 		{
-			req->send (500, "text/plain", "failed to schedule");
+			auto const lane  = static_cast< GCodeDevice::Lane > (i);
+			auto const stats = dev->getLaneStats (lane);
+
+			message += String (i == 0 ? "\r\n" : ",\r\n") + "    \"" +
+			    GCodeDevice::getLaneName (lane) + "\": { \"lines\": " +
+			    String (stats.lines) + ", \"bytes\": " + String (stats.bytes) +
+			    ", \"maxLines\": " + String (stats.maxLines) +
+			    ", \"sent\": " + String (stats.sent) +
+			    ", \"refused\": " + String (stats.refused) + " }";
 		}
+
+		message += "\r\n  }";
+
+		auto const activity = dev->getPollActivity ();
+
+		message += ",\r\n"
+		           "  \"statusPolling\": {\r\n"
+		           "    \"activity\": \"" +
+		    String (GCodeDevice::getPollActivityName (activity)) +
+		    "\",\r\n"
+		    "    \"intervalMs\": " +
+		    String (dev->getPollInterval ()) +
+		    ",\r\n"
+		    "    \"latencyMs\": " +
+		    String (dev->getStatusLatency ()) +
+		    ",\r\n"
+		    "    \"queries\": {";
+
+		for (int i = 0; i < GCodeDevice::QUERY_COUNT; i++)
+		{
+			auto const query = static_cast< GCodeDevice::StatusQuery > (i);
+			auto const stats = dev->getStatusQueryStats (query);
+
+			message += String (i == 0 ? "\r\n" : ",\r\n") + "      \"" +
+			    GCodeDevice::getStatusQueryName (query) + "\": { \"sent\": " +
+			    String (stats.sent) + ", \"skipped\": " +
+			    String (stats.skipped) + ", \"expired\": " +
+			    String (stats.expired) + ", \"rttMs\": " +
+			    String (stats.rttMs) + " }";
+		}
+
+		message += "\r\n    }\r\n  }";
+
+		if (dev->getType () == "marlin")
+		{
+			auto const marlin = static_cast< MarlinDevice* > (dev);
+			auto const& flow  = marlin->getFlowWindowStats ();
+
+			auto const average_window = flow.windowSamples
+			    ? 1.0f * flow.windowSum / flow.windowSamples
+			    : 0.0f;
+
+			String history;
+			for (auto&& window : marlin->getFlowWindowHistory ())
+			{
+				if (history.length () != 0)
+					history += ", ";
+				history += String (window);
+			}
+
+			message += ",\r\n"
+			           "  \"flowWindow\": {\r\n"
+			           "    \"window\": " +
+			    String (flow.window) +
+			    ",\r\n"
+			    "    \"min\": " +
+			    String (flow.minWindow) +
+			    ",\r\n"
+			    "    \"max\": " +
+			    String (flow.maxWindow) +
+			    ",\r\n"
+			    "    \"average\": " +
+			    String (average_window) +
+			    ",\r\n"
+			    "    \"commandBufferSize\": " +
+			    String (flow.commandBufferSize) +
+			    ",\r\n"
+			    "    \"plannerFree\": " +
+			    String (flow.plannerFree) +
+			    ",\r\n"
+			    "    \"bufferFree\": " +
+			    String (flow.bufferFree) +
+			    ",\r\n"
+			    "    \"history\": [" +
+			    history +
+			    "]\r\n"
+			    "  }";
+
+			auto const& resend = marlin->getResendStats ();
+
+			message += ",\r\n"
+			           "  \"lineChecksums\": {\r\n"
+			           "    \"enabled\": " +
+			    String (marlin->getLineChecksums () ? "true" : "false") +
+			    ",\r\n"
+			    "    \"lineErrors\": " +
+			    String (resend.lineErrors) +
+			    ",\r\n"
+			    "    \"resendRequests\": " +
+			    String (resend.requests) +
+			    ",\r\n"
+			    "    \"ignoredRequests\": " +
+			    String (resend.ignored) +
+			    ",\r\n"
+			    "    \"resentLines\": " +
+			    String (resend.resentLines) +
+			    "\r\n"
+			    "  }";
+
+			message += ",\r\n"
+			           "  \"autoreport\": {\r\n"
+			           "    \"temperature\": " +
+			    stringify (marlin->isTemperatureAutoreported ()) +
+			    ",\r\n"
+			    "    \"position\": " +
+			    stringify (marlin->isPositionAutoreported ()) +
+			    ",\r\n"
+			    "    \"positionTracked\": " +
+			    stringify (marlin->isPositionTracked ()) +
+			    "\r\n"
+			    "  }";
+		}
+
+		message += "\r\n}";
+
+		req->send (200, "application/json", message);
 	});
 }
@@ -16,6 +16,7 @@ void Job::readNextLine ()
 {
 	if (gcodeFile.available () == 0)
 	{
+		reachedEnd = true;
 		stop ();
 		return;
 	}
@@ -27,12 +28,19 @@ void Job::readNextLine ()
 			notify_observers (JobStatusEvent{0}); // every Nth byte
 		if (rd == '\n' || rd == '\r')
 		{
+			if (rd == '\n')
+				fileLines++;
 			if (curLinePos != 0)
 				break; // if it's an empty string or LF after last CR, just
 				       // continue reading
 		}
 		else
 		{
+			if (curLinePos == 0)
+			{
+				curLineNum    = fileLines + 1;
+				curLineOffset = filePos - 1;
+			}
 			if (curLinePos < MAX_LINE)
 				curLine[ curLinePos++ ] = rd;
 			else
@@ -44,6 +52,72 @@ void Job::readNextLine ()
 		}
 	}
 	curLine[ curLinePos ] = 0;
+
+	char* pos = strchr (curLine, ';');
+	if (pos != NULL)
+	{
+		*pos       = 0;
+		curLinePos = pos - curLine;
+	}
+}
+
+bool Job::resumeFrom (uint32_t line)
+{
+	if (running || filePath.length () == 0 || line == 0)
+		return false;
+
+	if (gcodeFile)
+		gcodeFile.close ();
+
+	gcodeFile = SD.open (filePath);
+	if (!gcodeFile)
+		return false;
+	fileSize = gcodeFile.size ();
+
+	const ResumeIndex::Checkpoint* checkpoint = resumeIndex.Find (line);
+	if (checkpoint != nullptr)
+	{
+		gcodeFile.seek (checkpoint->file_offset);
+		filePos     = checkpoint->file_offset;
+		fileLines   = checkpoint->line_number - 1;
+		resumeState = checkpoint->state;
+	}
+	else
+	{
+		filePos     = 0;
+		fileLines   = 0;
+		resumeState = ResumeState{};
+	}
+	curLinePos = 0;
+
+	// Leaves the line in curLine, to be sent after the preamble
+	while (true)
+	{
+		readNextLine ();
+		if (!gcodeFile)
+			return false; // past the end, stop() closed it
+		if (curLinePos == 0)
+			continue;
+		if (curLineNum >= line)
+			break;
+
+		resumeIndex.Add (curLineNum, curLineOffset, resumeState);
+		ApplyResumeLine (curLine, resumeState);
+		curLinePos = 0;
+	}
+
+	preambleLength =
+	    BuildResumePreamble (resumeState, preamble, RESUME_PREAMBLE_SIZE);
+	preamblePos = 0;
+	cancelled   = false;
+
+	J_DEBUGF (
+	    "Resuming at line %u from checkpoint %u\n",
+	    curLineNum,
+	    checkpoint != nullptr ? checkpoint->line_number : 0);
+
+	start ();
+	return true;
 }
 
 bool Job::scheduleNextCommand (GCodeDevice* dev)
@@ -57,17 +131,37 @@ bool Job::scheduleNextCommand (GCodeDevice* dev)
 	if (paused)
 		return false;
 
+	// Between two file lines, in the same lane so it waits its turn
+	if (canReportProgress (dev) &&
+	    (int32_t)(millis () - nextProgressReport) >= 0)
+	{
+		if (!submitProgressReport (dev, false))
+			return false;
+		nextProgressReport = millis () + progressReportInterval;
+		return true;
+	}
+
+	if (preamblePos < preambleLength)
+	{
+		const char* line = preamble + preamblePos;
+		size_t      len  = strchr (line, '\n') - line;
+
+		if (!dev->canSchedule (len, GCodeDevice::LANE_JOB) ||
+		    GCodeDevice::SubmitResult::OK !=
+		        dev->submitCommand (line, len, GCodeDevice::LANE_JOB))
+			return false;
+
+		preamblePos += len + 1;
+		return true;
+	}
+
 	if (curLinePos == 0)
 	{
 		readNextLine ();
 		if (!running)
-			return false; // don't run next time
-
-		char* pos = strchr (curLine, ';');
-		if (pos != NULL)
 		{
-			*pos       = 0;
-			curLinePos = pos - curLine;
+			finalProgressPending = reachedEnd && canReportProgress (dev);
+			return false; // don't run next time
 		}
 
 		bool empty = false; // true;
@@ -77,25 +171,26 @@ bool Job::scheduleNextCommand (GCodeDevice* dev)
 		{
 			return true;
 		} // can seek next
-
-#ifdef ADD_LINENUMBERS
-		char out[ MAX_LINE + 1 ];
-		snprintf (out, MAX_LINE, "N%d %s", ++curLineNum, curLine);
-		uint8_t checksum = 0, count = strlen (out);
-		while (count)
-			checksum ^= out[ --count ];
-		snprintf (curLine, MAX_LINE, "%s*%d", out, checksum);
-		curLinePos = strlen (curLine);
-#endif
 	}
 
-	if (dev->canSchedule (curLinePos))
+	if (dev->canSchedule (curLinePos, GCodeDevice::LANE_JOB))
 	{
 
 		J_DEBUGF ("  J queueing line '%s', len %d\n", curLine, curLinePos);
 
-		bool queued = dev->scheduleCommand (curLine, curLinePos);
-		assert (queued);
+		// Other tasks may have taken the room in the meantime, keep the line
+		// and retry on the next pass
+		if (GCodeDevice::SubmitResult::OK !=
+		    dev->submitCommand (
+		        curLine,
+		        curLinePos,
+		        GCodeDevice::LANE_JOB,
+		        LineOrigin{curLineOffset, curLineNum}))
+			return false;
+
+		resumeIndex.Add (curLineNum, curLineOffset, resumeState);
+		ApplyResumeLine (curLine, resumeState);
+		lastSentLine = curLineNum;
 
 		curLinePos = 0;
 		return true; // can try next command
@@ -104,15 +199,77 @@ bool Job::scheduleNextCommand (GCodeDevice* dev)
 		return false; // stop trying for now
 }
 
-void Job::loop ()
+uint32_t Job::getRemainingTime ()
 {
-	if (!running || paused)
-		return;
+	if (!running)
+		return UNKNOWN_TIME;
+
+	uint32_t now    = millis ();
+	uint32_t active = now - startTime - pausedTime;
+	if (paused)
+		active -= now - pauseStart;
+	uint32_t done = filePos - startFilePos;
+
+	if (active < MIN_ESTIMATE_TIME || done == 0)
+		return UNKNOWN_TIME;
+
+	return (uint64_t)active * (fileSize - filePos) / done;
+}
+
+bool Job::canReportProgress (GCodeDevice* dev)
+{
+	return progressReportInterval != 0 && dev->getType () == "marlin" &&
+	    static_cast< MarlinDevice* > (dev)->hasBuildPercentCap ();
+}
+
+bool Job::submitProgressReport (GCodeDevice* dev, bool final)
+{
+	char line[ 32 ];
+	int  len;
+	if (final)
+		len = snprintf (line, sizeof (line), "M73 P100 R0");
+	else
+	{
+		len = snprintf (
+		    line, sizeof (line), "M73 P%d", (int)(getCompletion () * 100));
+		uint32_t left = getRemainingTime ();
+		if (left != UNKNOWN_TIME)
+			len += snprintf (
+			    line + len,
+			    sizeof (line) - len,
+			    " R%u",
+			    (unsigned)((left + 59999) / 60000));
+	}
+
+	J_DEBUGF ("  J queueing progress '%s'\n", line);
 
+	return dev->canSchedule (len, GCodeDevice::LANE_JOB) &&
+	    GCodeDevice::SubmitResult::OK ==
+	    dev->submitCommand (line, len, GCodeDevice::LANE_JOB);
+}
+
+void Job::loop ()
+{
 	GCodeDevice* dev = GCodeDevice::getDevice ();
 	if (dev == nullptr)
 		return;
 
+	uint32_t resumeLine = pendingResumeLine.exchange (0);
+	if (resumeLine != 0)
+		resumeStatus.store (
+		    resumeFrom (resumeLine) ? RESUME_STARTED : RESUME_FAILED);
+
+	// The last file line may have filled the lane, so it is retried here
+	if (finalProgressPending && !running)
+	{
+		if (dev->isInPanic () || submitProgressReport (dev, true))
+			finalProgressPending = false;
+		return;
+	}
+
+	if (!running || paused)
+		return;
+
 	while (scheduleNextCommand (dev))
 	{
 	}
@@ -2,12 +2,12 @@
 
 #include <Arduino.h>
 #include <SD.h>
+#include <etl/atomic.h>
 #include <etl/observer.h>
 
+#include "JobResume.hpp"
 #include "devices/GCodeDevice.h"
 
-//#define ADD_LINENUMBERS
-
 // struct JobStatusEvent{  int status;  };
 typedef int JobStatusEvent;
 
@@ -31,6 +31,8 @@ typedef etl::observer< JobStatusEvent > JobObserver;
  *   [valid&running&paused]-+------------+
  *
  * ```
+ * A stopped job can be started again from any line with .resumeFrom, or
+ * with .requestResume from other tasks.
  */
 class Job : public DeviceObserver, public etl::observable< JobObserver, 3 > {
 
@@ -55,14 +57,26 @@ public:
 		gcodeFile = SD.open (file);
 		if (gcodeFile)
 			fileSize = gcodeFile.size ();
+		filePath  = file;
 		filePos   = 0;
 		running   = false;
 		paused    = false;
 		cancelled = false;
 		notify_observers (JobStatusEvent{0});
-		curLineNum = 0;
-		startTime  = 0;
-		endTime    = 0;
+		curLinePos     = 0;
+		curLineNum     = 0;
+		curLineOffset  = 0;
+		fileLines      = 0;
+		lastSentLine   = 0;
+		preambleLength = 0;
+		preamblePos    = 0;
+		resumeState    = ResumeState{};
+		resumeIndex.Clear ();
+		startTime            = 0;
+		endTime              = 0;
+		pausedTime           = 0;
+		finalProgressPending = false;
+		reachedEnd           = false;
 	}
 
 	void notification (const DeviceStatusEvent& e) override
@@ -76,9 +90,15 @@ public:
 
 	void start ()
 	{
-		startTime = millis ();
-		paused    = false;
-		running   = true;
+		startTime            = millis ();
+		endTime              = 0; // set by the stop() before a resume
+		startFilePos         = filePos;
+		pausedTime           = 0;
+		nextProgressReport   = startTime;
+		finalProgressPending = false;
+		reachedEnd           = false;
+		paused               = false;
+		running              = true;
 		notify_observers (JobStatusEvent{0});
 	}
 	void cancel ()
@@ -106,6 +126,10 @@ public:
 	}
 	void setPaused (bool v)
 	{
+		if (v && !paused)
+			pauseStart = millis ();
+		else if (!v && paused)
+			pausedTime += millis () - pauseStart;
 		paused = v;
 		notify_observers (JobStatusEvent{0});
 	}
@@ -114,6 +138,52 @@ public:
 		return paused;
 	}
 
+	/**
+	 * Starts the last file again at a line, after sending what the lines
+	 * before it set up: work coordinates, units, tool, spindle, coolant,
+	 * feed, and a move to where the line starts from. The file is only
+	 * scanned from the checkpoint before the line that the previous run
+	 * recorded.
+	 *
+	 * @return false if running, or the file or line is gone
+	 */
+	bool resumeFrom (uint32_t line);
+
+	enum ResumeStatus : uint8_t {
+		RESUME_NONE,
+		RESUME_PENDING, ///< Waiting for loop()
+		RESUME_STARTED,
+		RESUME_FAILED, ///< resumeFrom returned false
+	};
+
+	/**
+	 * Has loop() call resumeFrom, from any task. Scanning the file up to
+	 * the line can take long, too long for the web server task.
+	 */
+	void requestResume (uint32_t line)
+	{
+		resumeStatus.store (RESUME_PENDING);
+		pendingResumeLine.store (line);
+	}
+
+	/// Of the last requestResume
+	ResumeStatus getResumeStatus ()
+	{
+		return resumeStatus.load ();
+	}
+
+	/// The file line last handed to the device, 0 if none
+	uint32_t getLastSentLine ()
+	{
+		return lastSentLine;
+	}
+
+	/// The lines sent before the file on the last resume, '\n' separated
+	const char* getResumePreamble ()
+	{
+		return preambleLength != 0 ? preamble : "";
+	}
+
 	float getCompletion ()
 	{
 		if (isValid ())
@@ -151,17 +221,62 @@ public:
 		return (endTime != 0 ? endTime : millis ()) - startTime;
 	}
 
+	static const uint32_t UNKNOWN_TIME = UINT32_MAX;
+
+	/**
+	 * Estimated ms left while running, from the rate the file has been
+	 * read at since start() with pauses left out. UNKNOWN_TIME until
+	 * there is enough of a run to go by.
+	 */
+	uint32_t getRemainingTime ();
+
+	/**
+	 * Sends "M73 P<percent> R<minutes>" between the file lines every
+	 * interval, and "M73 P100 R0" at the end, to Marlin printers that
+	 * report Cap:BUILD_PERCENT. 0 turns the reports off.
+	 */
+	void setProgressReportInterval (uint32_t ms)
+	{
+		progressReportInterval = ms;
+	}
+
 private:
 	File             gcodeFile;
 	uint32_t         fileSize;
 	uint32_t         filePos;
 	uint32_t         startTime;
 	uint32_t         endTime;
+	uint32_t         startFilePos; ///< filePos at start(), past a resume
+	uint32_t         pausedTime;   ///< Since start()
+	uint32_t         pauseStart;
 	static const int MAX_LINE = 100;
 	char             curLine[ MAX_LINE + 1 ];
 	size_t           curLinePos;
 
-	size_t curLineNum;
+	uint32_t curLineNum;    ///< File line of curLine, from 1
+	uint32_t curLineOffset; ///< File offset of curLine
+	uint32_t fileLines;     ///< Line ends read so far
+	uint32_t lastSentLine;
+
+	String      filePath;
+	ResumeState resumeState; ///< Before curLine
+	ResumeIndex resumeIndex;
+
+	static const int RESUME_PREAMBLE_SIZE = 256;
+	char             preamble[ RESUME_PREAMBLE_SIZE ];
+	size_t           preambleLength;
+	size_t           preamblePos; ///< Of the next preamble line to send
+
+	etl::atomic< uint32_t >     pendingResumeLine{0};
+	etl::atomic< ResumeStatus > resumeStatus{RESUME_NONE};
+
+	/// Below it, the queue filling up makes the read rate look too fast
+	static const uint32_t MIN_ESTIMATE_TIME = 15000;
+
+	uint32_t progressReportInterval = 0;
+	uint32_t nextProgressReport;
+	bool     finalProgressPending; ///< Set at EOF, until M73 P100 is sent
+	bool     reachedEnd;           ///< Stopped at EOF, not midway
 
 	// float percentage = 0;
 	bool running;
@@ -179,6 +294,8 @@ private:
 	}
 	void readNextLine ();
 	bool scheduleNextCommand (GCodeDevice* dev);
+	bool canReportProgress (GCodeDevice* dev);
+	bool submitProgressReport (GCodeDevice* dev, bool final);
 
 	static Job job;
 };
@@ -0,0 +1,606 @@
+#include "JobResume.hpp"
+
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <etl/algorithm.h>
+
+
+namespace {
+	uint16_t constexpr kResumePosition = kResumeX | kResumeY | kResumeZ;
+
+	uint32_t constexpr kSpindleSpinUpSeconds = 3;
+
+	float constexpr kMmPerInch = 25.4f;
+
+
+	/**
+	 * Takes the next word from the line, skipping blanks and comments.
+	 *
+	 * @return false at the end of the line or on a malformed word
+	 */
+	bool NextWord (
+	    const char*& io_line, char& o_letter, float& o_value) noexcept
+	{
+		for (;;)
+		{
+			auto const c = *io_line;
+
+			if ((' ' == c) || ('\t' == c) || ('\r' == c) || ('\n' == c))
+			{
+				++io_line;
+			}
+			else if ('(' == c)
+			{
+				while (('\0' != *io_line) && (')' != *io_line))
+				{
+					++io_line;
+				}
+
+				if ('\0' == *io_line)
+				{
+					return false;
+				}
+
+				++io_line;
+			}
+			else if ((';' == c) || ('\0' == c))
+			{
+				return false;
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		o_letter = *io_line;
+
+		if (o_letter >= 'a' && o_letter <= 'z')
+		{
+			o_letter -= 'a' - 'A';
+		}
+
+		if (o_letter < 'A' || o_letter > 'Z')
+		{
+			return false;
+		}
+
+		char* end = nullptr;
+
+		o_value = strtof (io_line + 1, &end);
+
+		if (end == io_line + 1)
+		{
+			return false;
+		}
+
+		io_line = end;
+
+		return true;
+	}
+
+
+	void SetInches (ResumeState& io_state, bool i_inches) noexcept
+	{
+		if (io_state.inches == i_inches)
+		{
+			return;
+		}
+
+		auto const scale = i_inches ? 1.0f / kMmPerInch : kMmPerInch;
+
+		for (auto& coordinate : io_state.position)
+		{
+			coordinate *= scale;
+		}
+
+		io_state.safe_z *= scale;
+
+		if (!io_state.inverse_time)
+		{
+			io_state.feed *= scale;
+		}
+
+		io_state.inches = i_inches;
+	}
+
+
+	/// Appends a line and its '\n', false if it does not fit
+	bool AppendLine (
+	    char*       o_buffer,
+	    size_t      i_size,
+	    size_t&     io_length,
+	    const char* i_format,
+	    ...) noexcept __attribute__ ((format (printf, 4, 5)));
+
+	bool AppendLine (
+	    char*       o_buffer,
+	    size_t      i_size,
+	    size_t&     io_length,
+	    const char* i_format,
+	    ...) noexcept
+	{
+		va_list args;
+
+		va_start (args, i_format);
+
+		auto const written = vsnprintf (
+		    o_buffer + io_length, i_size - io_length, i_format, args);
+
+		va_end (args);
+
+		// Room for the '\n' and the terminator
+		if ((written < 0) ||
+		    (io_length + static_cast< size_t > (written) + 2 > i_size))
+		{
+			return false;
+		}
+
+		io_length += written;
+
+		o_buffer[ io_length++ ] = '\n';
+		o_buffer[ io_length ]   = '\0';
+
+		return true;
+	}
+} // namespace
+
+
+void ApplyResumeLine (const char* i_line, ResumeState& io_state) noexcept
+{
+	float   axis_values[ 3 ]{};
+	uint8_t axis_mask = 0;
+
+	auto axes_not_target = false; ///< G10, G28, G30 use them otherwise
+	auto sets_offsets    = false; ///< G92
+	auto machine_move    = false; ///< G53
+	auto loses_position  = false; ///< The move ends somewhere else
+	auto program_end     = false;
+
+	char  letter;
+	float value;
+
+	while (NextWord (i_line, letter, value))
+	{
+		auto const tenths = static_cast< int32_t > (lroundf (value * 10));
+
+		switch (letter)
+		{
+		case 'G': {
+			switch (tenths)
+			{
+			case 0:
+			case 10:
+			case 20:
+			case 30:
+				io_state.motion = tenths / 10;
+				io_state.known |= kResumeMotion;
+				break;
+
+			case 800:
+				io_state.known &= ~kResumeMotion;
+				break;
+
+			case 170:
+			case 180:
+			case 190:
+				io_state.plane = (tenths - 170) / 10;
+				break;
+
+			case 200:
+				SetInches (io_state, true);
+				break;
+
+			case 210:
+				SetInches (io_state, false);
+				break;
+
+			case 530:
+				machine_move = true;
+				break;
+
+			case 540:
+			case 550:
+			case 560:
+			case 570:
+			case 580:
+			case 590: {
+				auto const system =
+				    static_cast< uint8_t > ((tenths - 540) / 10);
+
+				// The same place has other work coordinates
+				if (system != io_state.coordinate_system)
+				{
+					io_state.known &= ~(kResumePosition | kResumeSafeZ);
+				}
+
+				io_state.coordinate_system = system;
+				io_state.known |= kResumeCoordinates;
+			}
+			break;
+
+			case 900:
+				io_state.incremental = false;
+				break;
+
+			case 910:
+				io_state.incremental = true;
+				break;
+
+			case 930:
+				io_state.inverse_time = true;
+				break;
+
+			case 940:
+				io_state.inverse_time = false;
+				break;
+
+			case 100:
+				axes_not_target = true;
+				break;
+
+			case 280:
+			case 300:
+				axes_not_target = true;
+				loses_position  = true;
+				break;
+
+			case 281:
+			case 301:
+			case 382:
+			case 383:
+			case 384:
+			case 385:
+			case 921:
+				loses_position = true;
+				break;
+
+			case 920:
+				sets_offsets = true;
+				break;
+
+			default:
+				break;
+			}
+		}
+		break;
+
+		case 'M': {
+			switch (tenths)
+			{
+			case 20:
+			case 300:
+				program_end = true;
+				break;
+
+			case 30:
+			case 40:
+			case 50:
+				io_state.spindle = tenths / 10;
+				break;
+
+			case 70:
+				io_state.mist = true;
+				break;
+
+			case 80:
+				io_state.flood = true;
+				break;
+
+			case 90:
+				io_state.mist  = false;
+				io_state.flood = false;
+				break;
+
+			default:
+				break;
+			}
+		}
+		break;
+
+		case 'F':
+			io_state.feed = value;
+			io_state.known |= kResumeFeed;
+			break;
+
+		case 'S':
+			io_state.spindle_speed = value;
+			io_state.known |= kResumeSpindle;
+			break;
+
+		case 'T':
+			io_state.tool = static_cast< uint16_t > (value);
+			io_state.known |= kResumeTool;
+			break;
+
+		case 'X':
+		case 'Y':
+		case 'Z':
+			axis_values[ letter - 'X' ] = value;
+			axis_mask |= 1 << (letter - 'X');
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	if (machine_move)
+	{
+		// Where that is in work coordinates is not known here
+		io_state.known &= ~axis_mask;
+	}
+	else if (!axes_not_target)
+	{
+		for (size_t axis = 0; axis < 3; ++axis)
+		{
+			uint16_t const field = 1 << axis;
+
+			if (!(axis_mask & field))
+			{
+				continue;
+			}
+
+			if (io_state.incremental && !sets_offsets)
+			{
+				io_state.position[ axis ] += axis_values[ axis ];
+			}
+			else
+			{
+				io_state.position[ axis ] = axis_values[ axis ];
+				io_state.known |= field;
+			}
+		}
+
+		if ((axis_mask & kResumeZ) && (io_state.known & kResumeZ))
+		{
+			auto const z = io_state.position[ 2 ];
+
+			io_state.safe_z = (io_state.known & kResumeSafeZ)
+			                      ? etl::max (io_state.safe_z, z)
+			                      : z;
+			io_state.known |= kResumeSafeZ;
+		}
+	}
+
+	if (loses_position)
+	{
+		io_state.known &= ~kResumePosition;
+	}
+
+	if (program_end)
+	{
+		if (0 != io_state.coordinate_system)
+		{
+			io_state.known &= ~(kResumePosition | kResumeSafeZ);
+		}
+
+		io_state.coordinate_system = 0;
+		io_state.plane             = 0;
+		io_state.motion            = 1;
+		io_state.spindle           = 5;
+		io_state.incremental       = false;
+		io_state.inverse_time      = false;
+		io_state.mist              = false;
+		io_state.flood             = false;
+	}
+}
+
+
+size_t BuildResumePreamble (
+    const ResumeState& i_state, char* o_buffer, size_t i_size) noexcept
+{
+	auto const known  = i_state.known;
+	auto       length = size_t{0};
+	auto       fits   = true;
+
+	if (0 == i_size)
+	{
+		return 0;
+	}
+
+	o_buffer[ 0 ] = '\0';
+
+	// Positioning is absolute, the file's distance mode comes last
+	fits = fits && AppendLine (
+	                   o_buffer,
+	                   i_size,
+	                   length,
+	                   "G%u G%u G90 G94",
+	                   17u + i_state.plane,
+	                   i_state.inches ? 20u : 21u);
+
+	if (known & kResumeCoordinates)
+	{
+		fits = fits && AppendLine (
+		                   o_buffer,
+		                   i_size,
+		                   length,
+		                   "G%u",
+		                   54u + i_state.coordinate_system);
+	}
+
+	if (known & kResumeTool)
+	{
+		fits = fits &&
+		       AppendLine (o_buffer, i_size, length, "T%u", i_state.tool);
+	}
+
+	if (known & kResumeSafeZ)
+	{
+		fits = fits && AppendLine (
+		                   o_buffer,
+		                   i_size,
+		                   length,
+		                   "G0 Z%.4f",
+		                   i_state.safe_z);
+	}
+
+	if ((3 == i_state.spindle) || (4 == i_state.spindle))
+	{
+		fits = fits && ((known & kResumeSpindle)
+		                    ? AppendLine (
+		                          o_buffer,
+		                          i_size,
+		                          length,
+		                          "M%u S%.0f",
+		                          i_state.spindle,
+		                          i_state.spindle_speed)
+		                    : AppendLine (
+		                          o_buffer,
+		                          i_size,
+		                          length,
+		                          "M%u",
+		                          i_state.spindle));
+
+		fits = fits && AppendLine (
+		                   o_buffer,
+		                   i_size,
+		                   length,
+		                   "G4 P%u",
+		                   kSpindleSpinUpSeconds);
+	}
+
+	if (i_state.mist)
+	{
+		fits = fits && AppendLine (o_buffer, i_size, length, "M7");
+	}
+
+	if (i_state.flood)
+	{
+		fits = fits && AppendLine (o_buffer, i_size, length, "M8");
+	}
+
+	if ((known & kResumeX) && (known & kResumeY))
+	{
+		fits = fits && AppendLine (
+		                   o_buffer,
+		                   i_size,
+		                   length,
+		                   "G0 X%.4f Y%.4f",
+		                   i_state.position[ 0 ],
+		                   i_state.position[ 1 ]);
+	}
+	else if (known & (kResumeX | kResumeY))
+	{
+		auto const axis = (known & kResumeX) ? 0 : 1;
+
+		fits = fits && AppendLine (
+		                   o_buffer,
+		                   i_size,
+		                   length,
+		                   "G0 %c%.4f",
+		                   'X' + axis,
+		                   i_state.position[ axis ]);
+	}
+
+	// Down at the cutting feed, nothing was cut before if there is none
+	if ((known & kResumeZ) && (known & kResumeFeed) && !i_state.inverse_time)
+	{
+		fits = fits && AppendLine (
+		                   o_buffer,
+		                   i_size,
+		                   length,
+		                   "G1 Z%.4f F%.1f",
+		                   i_state.position[ 2 ],
+		                   i_state.feed);
+	}
+	else if (known & kResumeZ)
+	{
+		fits = fits && AppendLine (
+		                   o_buffer,
+		                   i_size,
+		                   length,
+		                   "G0 Z%.4f",
+		                   i_state.position[ 2 ]);
+	}
+
+	// G2 and G3 cannot be set without a target, arc lines repeat them
+	if ((known & kResumeMotion) && (i_state.motion < 2))
+	{
+		fits = fits && AppendLine (
+		                   o_buffer, i_size, length, "G%u", i_state.motion);
+	}
+
+	if ((known & kResumeFeed) && !i_state.inverse_time)
+	{
+		fits = fits &&
+		       AppendLine (o_buffer, i_size, length, "F%.1f", i_state.feed);
+	}
+
+	if (i_state.inverse_time)
+	{
+		fits = fits && AppendLine (o_buffer, i_size, length, "G93");
+	}
+
+	if (i_state.incremental)
+	{
+		fits = fits && AppendLine (o_buffer, i_size, length, "G91");
+	}
+
+	return fits ? length : 0;
+}
+
+
+void ResumeIndex::Clear () noexcept
+{
+	checkpoints_.clear ();
+
+	spacing_   = kInitialSpacing;
+	next_line_ = 1;
+}
+
+
+void ResumeIndex::Add (
+    uint32_t           i_line_number,
+    uint32_t           i_file_offset,
+    const ResumeState& i_state) noexcept
+{
+	if (i_line_number < next_line_)
+	{
+		return;
+	}
+
+	if (checkpoints_.full ())
+	{
+		size_t kept = 0;
+
+		for (size_t i = 0; i < checkpoints_.size (); i += 2)
+		{
+			checkpoints_[ kept++ ] = checkpoints_[ i ];
+		}
+
+		checkpoints_.resize (kept);
+
+		spacing_ *= 2;
+		next_line_ = checkpoints_.back ().line_number + spacing_;
+
+		if (i_line_number < next_line_)
+		{
+			return;
+		}
+	}
+
+	checkpoints_.push_back (Checkpoint{i_line_number, i_file_offset, i_state});
+
+	next_line_ = i_line_number + spacing_;
+}
+
+
+auto ResumeIndex::Find (uint32_t i_line_number) const noexcept
+    -> const Checkpoint*
+{
+	for (auto i = checkpoints_.size (); i > 0; --i)
+	{
+		if (checkpoints_[ i - 1 ].line_number <= i_line_number)
+		{
+			return &checkpoints_[ i - 1 ];
+		}
+	}
+
+	return nullptr;
+}
@@ -0,0 +1,114 @@
+#ifndef SRC_JOBRESUME_HPP
+#define SRC_JOBRESUME_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <etl/vector.h>
+
+
+/// Parts of ResumeState that were set by the file
+enum ResumeField : uint16_t {
+	kResumeX           = 1 << 0,
+	kResumeY           = 1 << 1,
+	kResumeZ           = 1 << 2,
+	kResumeSafeZ       = 1 << 3,
+	kResumeFeed        = 1 << 4,
+	kResumeSpindle     = 1 << 5,
+	kResumeTool        = 1 << 6,
+	kResumeMotion      = 1 << 7,
+	kResumeCoordinates = 1 << 8,
+};
+
+
+/**
+ * Machine context a G-code file has set up before some line: what a job
+ * started at that line needs to send first. Positions are in the file's
+ * units and work coordinates.
+ */
+struct ResumeState {
+	float position[ 3 ]{}; ///< X, Y, Z
+	float safe_z{0};       ///< Highest Z moved to, the retract height
+	float feed{0};
+	float spindle_speed{0};
+
+	uint16_t tool{0};
+	uint16_t known{0}; ///< ResumeField bits
+
+	uint8_t coordinate_system{0}; ///< 0 for G54 up to 5 for G59
+	uint8_t plane{0};             ///< 0 for G17, 1 for G18, 2 for G19
+	uint8_t motion{0};            ///< 0 to 3 for G0 to G3
+	uint8_t spindle{5};           ///< 3, 4 or 5 for M3, M4 or M5
+
+	bool inches{false};
+	bool incremental{false};
+	bool inverse_time{false}; ///< G93
+	bool mist{false};         ///< M7
+	bool flood{false};        ///< M8
+};
+
+
+/// Updates the state with a line of the file, comments included
+void ApplyResumeLine (const char* i_line, ResumeState& io_state) noexcept;
+
+
+/**
+ * Writes the lines that bring a machine into the state, separated by '\n':
+ * modes, tool, spindle and coolant, then a move at the retract height over
+ * the position and down to it.
+ *
+ * @return length written, 0 if the buffer is too small
+ */
+size_t BuildResumePreamble (
+    const ResumeState& i_state, char* o_buffer, size_t i_size) noexcept;
+
+
+/**
+ * The state at lines spread over a file, recorded while a job streams it,
+ * so a resume only has to scan from the nearest one. When it is full every
+ * other checkpoint is dropped and the spacing doubles.
+ */
+class ResumeIndex {
+public:
+	struct Checkpoint {
+		uint32_t    line_number{0}; ///< From 1
+		uint32_t    file_offset{0}; ///< Of the line start
+		ResumeState state;          ///< Before the line
+	};
+
+	void Clear () noexcept;
+
+	/// Records the state before the line if a checkpoint is due
+	void Add (
+	    uint32_t           i_line_number,
+	    uint32_t           i_file_offset,
+	    const ResumeState& i_state) noexcept;
+
+	/// The last checkpoint at or before the line, nullptr if none
+	const Checkpoint* Find (uint32_t i_line_number) const noexcept;
+
+	size_t Size () const noexcept
+	{
+		return checkpoints_.size ();
+	}
+
+	uint32_t Spacing () const noexcept
+	{
+		return spacing_;
+	}
+
+
+private:
+	static size_t constexpr kCapacity = 64;
+
+	static uint32_t constexpr kInitialSpacing = 128; ///< Lines
+
+	etl::vector< Checkpoint, kCapacity > checkpoints_;
+
+	uint32_t spacing_{kInitialSpacing};
+	uint32_t next_line_{1};
+};
+
+
+#endif // SRC_JOBRESUME_HPP
@@ -0,0 +1,214 @@
+#ifndef SRC_LINEARENA_HPP
+#define SRC_LINEARENA_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <etl/atomic.h>
+
+
+using LineHandle = uint8_t;
+
+static LineHandle constexpr kNoLine = 0xFF;
+
+
+/// Where a line came from, to trace device errors back to it
+struct LineOrigin {
+	uint32_t file_offset{0};   ///< Of the job file line
+	uint32_t line_number{0};   ///< Job file line, 0 for lines not from a job
+	bool     modes_only{false}; ///< May be dropped if its modes are set
+};
+
+
+/**
+ * Fixed pool of G-code line slots shared by all stages of the device command
+ * pipeline.
+ *
+ * A line is copied into a slot exactly once, when it is scheduled. After that
+ * only the slot handle moves between the scheduled lanes and the sent queue.
+ * The slot is released once the line is no longer needed: right after sending
+ * for devices that count characters only, after acknowledgement for devices
+ * that need to look at the command they are getting a response for.
+ *
+ * Allocation is lock-free and may happen in any task. Release is expected to
+ * happen in the device task.
+ */
+class LineArena {
+public:
+	static size_t constexpr kMaxSlotCount = 32;
+
+
+	LineArena (const LineArena&) = delete;
+	LineArena& operator= (const LineArena&) = delete;
+
+
+	/**
+	 * Copies the line into a free slot. Lines longer than the slot are
+	 * truncated.
+	 *
+	 * @return Handle of the slot or kNoLine if there are no free slots.
+	 */
+	LineHandle Allocate (
+	    const char*       i_line,
+	    size_t            i_length,
+	    const LineOrigin& i_origin = LineOrigin{}) noexcept
+	{
+		auto used_slots = used_slots_.load (etl::memory_order_relaxed);
+		auto slot       = LineHandle{};
+
+		do
+		{
+			auto const free_slots = ~used_slots & all_slots_mask_;
+
+			if (0 == free_slots)
+			{
+				return kNoLine;
+			}
+
+			slot = static_cast< LineHandle > (__builtin_ctz (free_slots));
+		} while (!used_slots_.compare_exchange_weak (
+		    used_slots,
+		    used_slots | (uint32_t{1} << slot),
+		    etl::memory_order_acquire,
+		    etl::memory_order_relaxed));
+
+		if (i_length > slot_size_ - 1)
+		{
+			i_length = slot_size_ - 1;
+		}
+
+		auto const data = Data (slot);
+
+		memcpy (data, i_line, i_length);
+
+		data[ i_length ] = 0;
+		lengths_[ slot ] = static_cast< uint8_t > (i_length);
+		origins_[ slot ] = i_origin;
+
+		return slot;
+	}
+
+
+	void Release (LineHandle i_line) noexcept
+	{
+		if (kNoLine == i_line)
+		{
+			return;
+		}
+
+		used_slots_.fetch_and (
+		    ~(uint32_t{1} << i_line), etl::memory_order_release);
+	}
+
+
+	/// Zero-terminated line text
+	char* Data (LineHandle i_line) const noexcept
+	{
+		return storage_ + i_line * slot_size_;
+	}
+
+
+	size_t Length (LineHandle i_line) const noexcept
+	{
+		return lengths_[ i_line ];
+	}
+
+
+	const LineOrigin& Origin (LineHandle i_line) const noexcept
+	{
+		return origins_[ i_line ];
+	}
+
+
+	/// Updates length after in-place modification of the line text
+	void SetLength (LineHandle i_line, size_t i_length) noexcept
+	{
+		lengths_[ i_line ] = static_cast< uint8_t > (
+		    i_length < slot_size_ ? i_length : slot_size_ - 1);
+
+		Data (i_line)[ lengths_[ i_line ] ] = 0;
+	}
+
+
+	size_t MaxLineLength () const noexcept
+	{
+		return slot_size_ - 1;
+	}
+
+
+	size_t SlotCount () const noexcept
+	{
+		return slot_count_;
+	}
+
+
+	size_t FreeSlots () const noexcept
+	{
+		return __builtin_popcount (
+		    ~used_slots_.load (etl::memory_order_relaxed) & all_slots_mask_);
+	}
+
+
+protected:
+	LineArena (
+	    char*       io_storage,
+	    uint8_t*    io_lengths,
+	    LineOrigin* io_origins,
+	    size_t      i_slot_count,
+	    size_t      i_slot_size) noexcept
+	    : storage_{io_storage}
+	    , lengths_{io_lengths}
+	    , origins_{io_origins}
+	    , slot_count_{i_slot_count}
+	    , slot_size_{i_slot_size}
+	    , all_slots_mask_{
+	          i_slot_count == kMaxSlotCount
+	              ? ~uint32_t{}
+	              : ((uint32_t{1} << i_slot_count) - 1)}
+	{
+	}
+
+
+private:
+	char* const       storage_;
+	uint8_t* const    lengths_;
+	LineOrigin* const origins_;
+	size_t const      slot_count_;
+	size_t const      slot_size_;
+	uint32_t const    all_slots_mask_;
+
+	etl::atomic< uint32_t > used_slots_{0};
+};
+
+
+template < size_t KSlotCount, size_t KMaxLineLength >
+class StaticLineArena : public LineArena {
+	static_assert (
+	    KSlotCount <= LineArena::kMaxSlotCount,
+	    "Slot occupancy is tracked with a 32-bit mask");
+
+	static_assert (
+	    KMaxLineLength < 256, "Line length is stored in a single byte");
+
+public:
+	StaticLineArena () noexcept
+	    : LineArena (
+	          &data_[ 0 ][ 0 ],
+	          lengths_,
+	          origins_,
+	          KSlotCount,
+	          KMaxLineLength + 1)
+	{
+	}
+
+
+private:
+	char       data_[ KSlotCount ][ KMaxLineLength + 1 ];
+	uint8_t    lengths_[ KSlotCount ];
+	LineOrigin origins_[ KSlotCount ];
+};
+
+
+#endif // SRC_LINEARENA_HPP
@@ -0,0 +1,162 @@
+#ifndef SRC_MPSCQUEUE_HPP
+#define SRC_MPSCQUEUE_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <etl/atomic.h>
+
+
+/**
+ * Bounded lock-free queue for any number of producer tasks and a single
+ * consumer task.
+ *
+ * Every cell carries a sequence number that tells whose turn it is: a
+ * producer claims a cell by advancing the enqueue position with CAS, writes
+ * the value and then publishes the cell by bumping its sequence. The
+ * consumer takes values strictly in claim order, so values pushed by one
+ * producer come out in the order they were pushed.
+ *
+ * A value that is claimed but not published yet holds back the values after
+ * it, pop() reports an empty queue until it is published.
+ */
+template < typename T, size_t KCapacity >
+class MpscQueue {
+	static_assert (
+	    KCapacity >= 2 && 0 == (KCapacity & (KCapacity - 1)),
+	    "Capacity must be a power of two");
+
+public:
+	MpscQueue () noexcept
+	{
+		for (size_t i = 0; i < KCapacity; ++i)
+		{
+			cells_[ i ].sequence.store (i, etl::memory_order_relaxed);
+		}
+	}
+
+
+	MpscQueue (const MpscQueue&) = delete;
+	MpscQueue& operator= (const MpscQueue&) = delete;
+
+
+	/// Safe from any task, but not from an ISR
+	bool push (const T& i_value) noexcept
+	{
+		auto  position = enqueue_position_.load (etl::memory_order_relaxed);
+		Cell* cell     = nullptr;
+
+		while (true)
+		{
+			cell = &cells_[ position & kMask ];
+
+			auto const sequence =
+			    cell->sequence.load (etl::memory_order_acquire);
+			auto const lag = static_cast< intptr_t > (sequence) -
+			    static_cast< intptr_t > (position);
+
+			if (0 == lag)
+			{
+				if (enqueue_position_.compare_exchange_weak (
+				        position,
+				        position + 1,
+				        etl::memory_order_relaxed,
+				        etl::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (lag < 0)
+			{
+				return false; // full
+			}
+			else
+			{
+				position = enqueue_position_.load (etl::memory_order_relaxed);
+			}
+		}
+
+		cell->value = i_value;
+		cell->sequence.store (position + 1, etl::memory_order_release);
+
+		return true;
+	}
+
+
+	/// Consumer task only
+	bool pop (T& o_value) noexcept
+	{
+		auto const position =
+		    dequeue_position_.load (etl::memory_order_relaxed);
+		auto& cell = cells_[ position & kMask ];
+
+		if (cell.sequence.load (etl::memory_order_acquire) != position + 1)
+		{
+			return false;
+		}
+
+		o_value = cell.value;
+
+		cell.sequence.store (position + KCapacity, etl::memory_order_release);
+		dequeue_position_.store (position + 1, etl::memory_order_relaxed);
+
+		return true;
+	}
+
+
+	/// Includes claimed values that are not published yet
+	size_t size () const noexcept
+	{
+		auto const dequeued =
+		    dequeue_position_.load (etl::memory_order_relaxed);
+		auto const enqueued =
+		    enqueue_position_.load (etl::memory_order_relaxed);
+
+		return enqueued - dequeued;
+	}
+
+
+	size_t available () const noexcept
+	{
+		auto const used = size ();
+
+		return used < KCapacity ? KCapacity - used : 0;
+	}
+
+
+	bool empty () const noexcept
+	{
+		return 0 == size ();
+	}
+
+
+	bool full () const noexcept
+	{
+		return size () >= KCapacity;
+	}
+
+
+	size_t capacity () const noexcept
+	{
+		return KCapacity;
+	}
+
+
+private:
+	static size_t constexpr kMask = KCapacity - 1;
+
+
+	struct Cell {
+		etl::atomic< size_t > sequence;
+		T                     value;
+	};
+
+
+	Cell                  cells_[ KCapacity ];
+	etl::atomic< size_t > enqueue_position_{0};
+	etl::atomic< size_t > dequeue_position_{0};
+};
+
+
+#endif // SRC_MPSCQUEUE_HPP
@@ -0,0 +1,137 @@
+#ifndef SRC_RESPONSEFRAMER_HPP
+#define SRC_RESPONSEFRAMER_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+
+/**
+ * Splits the device response stream into lines.
+ *
+ * Received data is written in blocks directly into the framer buffer. Line
+ * ends are found with memchr() and complete lines are handed out in place,
+ * zero-terminated, without copying. Only the incomplete tail is moved to the
+ * front of the buffer once all complete lines are handled.
+ *
+ * A line longer than the buffer is handed out truncated, the rest of it is
+ * dropped and the line is counted as overflowed.
+ */
+template < size_t KMaxLineLength >
+class ResponseFramer {
+public:
+	/// Where the next received block goes
+	char* WritePointer () noexcept
+	{
+		return buffer_ + length_;
+	}
+
+
+	/// Never 0 after ForEachLine()
+	size_t WriteSpace () const noexcept
+	{
+		return KMaxLineLength - length_;
+	}
+
+
+	void Commit (size_t i_length) noexcept
+	{
+		length_ += i_length;
+	}
+
+
+	/**
+	 * Calls i_handler (char* line, size_t length) for every complete line.
+	 * Line end characters are not part of the line, empty lines are skipped.
+	 * The line is only valid during the call.
+	 */
+	template < typename THandler >
+	void ForEachLine (THandler&& i_handler)
+	{
+		auto begin = size_t{0};
+
+		while (auto const end = static_cast< char* > (
+		           memchr (buffer_ + scanned_, '\n', length_ - scanned_)))
+		{
+			auto const line_end = static_cast< size_t > (end - buffer_);
+
+			if (!discarding_)
+			{
+				HandleLine (begin, line_end, i_handler);
+			}
+
+			discarding_ = false;
+			begin       = line_end + 1;
+			scanned_    = begin;
+		}
+
+		length_ -= begin;
+		memmove (buffer_, buffer_ + begin, length_);
+		scanned_ = length_;
+
+		if (KMaxLineLength == length_)
+		{
+			if (!discarding_)
+			{
+				HandleLine (0, length_, i_handler);
+
+				++overflowed_lines_;
+			}
+
+			discarding_ = true;
+			length_     = 0;
+			scanned_    = 0;
+		}
+	}
+
+
+	/// Drops the incomplete line, e.g. after the device was reset
+	void Clear () noexcept
+	{
+		length_     = 0;
+		scanned_    = 0;
+		discarding_ = false;
+	}
+
+
+	uint32_t OverflowedLines () const noexcept
+	{
+		return overflowed_lines_;
+	}
+
+
+private:
+	template < typename THandler >
+	void HandleLine (size_t i_begin, size_t i_end, THandler& i_handler)
+	{
+		while (i_begin < i_end && '\r' == buffer_[ i_begin ])
+		{
+			++i_begin;
+		}
+
+		while (i_end > i_begin && '\r' == buffer_[ i_end - 1 ])
+		{
+			--i_end;
+		}
+
+		if (i_begin == i_end)
+		{
+			return;
+		}
+
+		buffer_[ i_end ] = 0;
+
+		i_handler (buffer_ + i_begin, i_end - i_begin);
+	}
+
+
+	char     buffer_[ KMaxLineLength + 1 ];
+	size_t   length_           = 0;
+	size_t   scanned_          = 0; ///< Bytes known to contain no line end
+	bool     discarding_       = false;
+	uint32_t overflowed_lines_ = 0;
+};
+
+
+#endif // SRC_RESPONSEFRAMER_HPP
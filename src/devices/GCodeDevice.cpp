@@ -144,170 +144,650 @@ void GCodeDevice::setDevice(GCodeDevice *dev) {
 }
 */
 
-void GCodeDevice::sendCommands ()
+// Lines, bytes, arena slots left to the lanes above, fair share
+const GCodeDevice::LaneBudget GCodeDevice::LANE_BUDGETS[ LANE_COUNT ] = {
+    {8, 256, 0, 0},      // realtime
+    {8, 512, 2, 0},      // jog
+    {16, 1024, 4, 128},  // interactive
+    {16, 2048, 6, 384}}; // job, three times the interactive share
+
+const char* GCodeDevice::getLaneName (Lane lane)
 {
-	// bool loadedNewCmd=false;
+	static const char* const NAMES[ LANE_COUNT ] = {
+	    "realtime", "jog", "interactive", "job"};
+	return lane < LANE_COUNT ? NAMES[ lane ] : "";
+}
 
-	if (xoffEnabled && xoff)
-		return;
+GCodeDevice::SubmitResult GCodeDevice::submitCommand (
+    const char* cmd, size_t len, Lane lane, const LineOrigin& origin)
+{
+	if (panic && lane != LANE_REALTIME)
+		return countSubmit (SubmitResult::PANIC);
+	if (len == 0 || !lineArena)
+		return SubmitResult::EMPTY;
 
-#ifdef ADD_LINECOMMENTS
-	static size_t nline = 0;
-#endif
+	const LaneBudget& budget = LANE_BUDGETS[ lane ];
+	LaneState&        state  = lanes[ lane ];
+
+	// Lanes above can always get some slots, a job can't lock them out
+	if (lineArena->FreeSlots () <= budget.slotReserve)
+		return countSubmit (SubmitResult::NO_SLOTS);
+
+	len = min (len, lineArena->MaxLineLength ());
 
-	if (curUnsentPriorityCmdLen == 0)
+	// Reserve room in the budget first, several tasks may submit at once
+	uint16_t depth = state.lines.fetch_add (1) + 1;
+	uint16_t bytes = state.bytes.fetch_add (len) + len;
+	if (depth > budget.lines || bytes > budget.bytes)
 	{
-#ifdef ADD_LINECOMMENTS
-		char tmp[ MAX_GCODE_LINE + 1 ];
-		curUnsentPriorityCmdLen =
-		    xMessageBufferReceive (buf0, tmp, MAX_GCODE_LINE, 0);
-		if (curUnsentPriorityCmdLen != 0)
-		{
-			tmp[ curUnsentPriorityCmdLen ] = 0;
-			snprintf (
-			    curUnsentPriorityCmd, MAX_GCODE_LINE, "%s ;%d", tmp, nline++);
-			curUnsentPriorityCmdLen = strlen (curUnsentPriorityCmd);
-		}
-#else
-		curUnsentPriorityCmdLen = xMessageBufferReceive (
-		    priority_buf, curUnsentPriorityCmd, MAX_GCODE_LINE, 0);
-		curUnsentPriorityCmd[ curUnsentPriorityCmdLen ] = 0;
-#endif
+		state.lines.fetch_sub (1);
+		state.bytes.fetch_sub (len);
+		state.refused.fetch_add (1);
+		return countSubmit (SubmitResult::LANE_FULL);
 	}
 
-	if (!panic && (0 == curUnsentPriorityCmdLen) && (0 == curUnsentCmdLen))
+	LineHandle line = lineArena->Allocate (cmd, len, origin);
+	if (line == kNoLine || !state.queue.push (line))
 	{
-#ifdef ADD_LINECOMMENTS
-		char tmp[ MAX_GCODE_LINE + 1 ];
-		curUnsentCmdLen =
-		    xMessageBufferReceive (regular_buf, tmp, MAX_GCODE_LINE, 0);
-		if (curUnsentCmdLen != 0)
+		lineArena->Release (line);
+		state.lines.fetch_sub (1);
+		state.bytes.fetch_sub (len);
+		return countSubmit (
+		    line == kNoLine ? SubmitResult::NO_SLOTS : SubmitResult::LANE_FULL);
+	}
+
+	uint16_t maxLines = state.maxLines.load ();
+	while (depth > maxLines &&
+	       !state.maxLines.compare_exchange_weak (maxLines, depth))
+		;
+
+	notifyEvent (EVENT_COMMAND);
+	return countSubmit (SubmitResult::OK);
+}
+
+bool GCodeDevice::canSchedule (size_t len, Lane lane)
+{
+	if (panic && lane != LANE_REALTIME)
+		return false;
+	if (!lineArena)
+		return false;
+	if (len == 0)
+		return false;
+	const LaneBudget& budget = LANE_BUDGETS[ lane ];
+	const LaneState&  state  = lanes[ lane ];
+	return lineArena->FreeSlots () > budget.slotReserve &&
+	    state.lines.load () < budget.lines &&
+	    state.bytes.load () + min (len, lineArena->MaxLineLength ()) <=
+	    budget.bytes;
+}
+
+GCodeDevice::LaneStats GCodeDevice::getLaneStats (Lane lane) const
+{
+	const LaneState& state = lanes[ lane ];
+	return LaneStats{
+	    state.lines.load (),
+	    state.bytes.load (),
+	    state.maxLines.load (),
+	    state.sent,
+	    state.refused.load ()};
+}
+
+LineHandle GCodeDevice::laneHead (Lane lane)
+{
+	LaneState& state = lanes[ lane ];
+	if (state.head == kNoLine && state.queue.pop (state.head))
+	{
+		// Accounted with the submitted length, comments are not
+		state.headBytes = lineArena->Length (state.head);
+		addLineComment (state.head);
+	}
+	return state.head;
+}
+
+void GCodeDevice::accountLaneHead (Lane lane)
+{
+	LaneState& state = lanes[ lane ];
+	state.lines.fetch_sub (1);
+	state.bytes.fetch_sub (state.headBytes);
+}
+
+void GCodeDevice::dropLane (Lane lane)
+{
+	LaneState& state = lanes[ lane ];
+	while (laneHead (lane) != kNoLine)
+	{
+		lineArena->Release (state.head);
+		state.head = kNoLine;
+		accountLaneHead (lane);
+	}
+	state.deficit = 0;
+}
+
+GCodeDevice::Lane GCodeDevice::nextLane ()
+{
+	if (laneHead (LANE_REALTIME) != kNoLine)
+		return LANE_REALTIME;
+	if (panic)
+		return LANE_COUNT;
+	if (laneHead (LANE_JOG) != kNoLine)
+		return LANE_JOG;
+
+	// Deficit round robin on bytes. A lane with a line always gets its turn
+	// served since quanta are larger than any line, so two rounds are enough.
+	for (int i = 0; i < 4; i++)
+	{
+		LaneState& state = lanes[ fairLane ];
+		LineHandle line  = laneHead (fairLane);
+		if (line != kNoLine)
 		{
-			tmp[ curUnsentCmdLen ] = 0;
-			snprintf (curUnsentCmd, MAX_GCODE_LINE, "%s ;%d", tmp, nline++);
-			curUnsentCmdLen = strlen (curUnsentCmd);
+			if (!fairTurnStarted)
+			{
+				state.deficit += LANE_BUDGETS[ fairLane ].quantum;
+				fairTurnStarted = true;
+			}
+			if (state.deficit >= (int32_t)lineArena->Length (line) + 1)
+				return fairLane;
 		}
-#else
-		curUnsentCmdLen = xMessageBufferReceive (
-		    regular_buf, curUnsentCmd, MAX_GCODE_LINE, 0);
-		curUnsentCmd[ curUnsentCmdLen ] = 0;
-#endif
-		// loadedNewCmd = true;
+		else
+			state.deficit = 0; // an idle lane does not save up
+
+		fairLane = fairLane == LANE_INTERACTIVE ? LANE_JOB : LANE_INTERACTIVE;
+		fairTurnStarted = false;
 	}
+	return LANE_COUNT;
+}
+
+void GCodeDevice::addLineComment (LineHandle line)
+{
+#ifdef ADD_LINECOMMENTS
+	static size_t nline = 0;
+
+	// Slots are sized for the longest line, so the comment is appended in place
+	char*  cmd = lineArena->Data (line);
+	size_t len = lineArena->Length (line);
+	len += snprintf (
+	    cmd + len, lineArena->MaxLineLength () - len + 1, " ;%d", nline++);
+	lineArena->SetLength (line, len);
+#endif
+}
+
+const char* GCodeDevice::getPollActivityName (PollActivity activity)
+{
+	static const char* const NAMES[ POLL_ACTIVITY_COUNT ] = {
+	    "idle", "active", "alarm"};
+	return activity < POLL_ACTIVITY_COUNT ? NAMES[ activity ] : "";
+}
+
+GCodeDevice::PollActivity GCodeDevice::pollActivity ()
+{
+	if (panic)
+		return POLL_ALARM;
+	if (getQueueLength () > 0 || sentCounter->bytes () > 0)
+		return POLL_ACTIVE;
+	return POLL_IDLE;
+}
 
-	// Also happens when in panic and there are no priority commands.
-	if ((0 == curUnsentCmdLen) && (0 == curUnsentPriorityCmdLen))
+void GCodeDevice::pollStatus ()
+{
+	if (nextStatusRequestTime == 0)
+		return;
+
+	lastPollActivity = pollActivity ();
+
+	uint32_t interval;
+	switch (lastPollActivity)
 	{
+	case POLL_ACTIVE:
+		interval = pollRates.active;
+		break;
+	case POLL_ALARM:
+		interval = pollRates.alarm;
+		break;
+	default:
+		interval = pollRates.idle;
+		break;
+	}
+	// Requests sent faster than replies come back only pile up in the link
+	interval = max (interval, getStatusLatency () * STATUS_POLL_LATENCY_FACTOR);
+	pollInterval = interval;
+
+	// The machine may have started moving since the request was scheduled
+	if (lastStatusRequestTime != 0 &&
+	    nextStatusRequestTime - lastStatusRequestTime > interval)
+		nextStatusRequestTime = lastStatusRequestTime + interval;
+
+	uint32_t now = millis ();
+	if ((int32_t)(now - nextStatusRequestTime) < 0)
 		return;
+
+	requestStatusUpdate ();
+
+	lastStatusRequestTime = now;
+	nextStatusRequestTime = now + interval;
+}
+
+const char* GCodeDevice::getStatusQueryName (StatusQuery query)
+{
+	static const char* const NAMES[ QUERY_COUNT ] = {
+	    "position", "temperature"};
+	return query < QUERY_COUNT ? NAMES[ query ] : "";
+}
+
+bool GCodeDevice::beginStatusQuery (StatusQuery query)
+{
+	StatusQueryState& state = statusQueries[ query ];
+
+	uint32_t now    = millis () | 1; // 0 means nothing is unanswered
+	uint32_t issued = state.issuedAt.load ();
+
+	if ((issued != 0 && now - issued < STATUS_QUERY_TIMEOUT) ||
+	    !state.issuedAt.compare_exchange_strong (issued, now))
+	{
+		state.skipped.fetch_add (1);
+		return false;
 	}
 
-	trySendCommand ();
+	if (issued != 0)
+		state.expired.fetch_add (1);
+	state.sent.fetch_add (1);
+	return true;
 }
 
-void GCodeDevice::receiveResponses ()
+void GCodeDevice::cancelStatusQuery (StatusQuery query)
+{
+	StatusQueryState& state = statusQueries[ query ];
+
+	state.issuedAt.store (0);
+	state.sent.fetch_sub (1);
+}
+
+void GCodeDevice::statusQueryAnswered (StatusQuery query)
+{
+	StatusQueryState& state = statusQueries[ query ];
+
+	uint32_t issued = state.issuedAt.exchange (0);
+	if (issued == 0)
+		return; // Not asked for, e.g. a query sent by another client
+
+	uint32_t rtt = min (millis () - issued, (uint32_t)STATUS_LATENCY_MAX);
+
+	// Averaged over a few replies, a single slow one doesn't halve the rate
+	state.rttMs = state.rttMs == 0 ? rtt : (state.rttMs * 3 + rtt) / 4;
+}
+
+uint32_t GCodeDevice::nextEventTimeout ()
 {
+	uint32_t now     = millis ();
+	uint32_t timeout = DEVICE_EVENT_WAIT_MAX;
 
-	static const size_t MAX_LINE = 200; // M115 is far longer than 100
-	static char         resp[ MAX_LINE + 1 ];
-	static size_t       respLen;
+	if (nextStatusRequestTime != 0)
+		timeout = min (
+		    timeout,
+		    nextStatusRequestTime > now ? nextStatusRequestTime - now : 0);
+
+	if (isRxTimeoutEnabled ())
+		timeout =
+		    min (timeout, serialRxTimeout > now ? serialRxTimeout - now : 0);
+
+	return min (timeout, nextActionDelay ());
+}
+
+void GCodeDevice::waitForEvent ()
+{
+	uint32_t sleepStart = micros ();
+	busyTimeUs += sleepStart - lastWakeTime;
+
+	uint32_t events = 0;
+#ifdef DEVICE_TASK_POLLING
+	xTaskNotifyWait (0, UINT32_MAX, &events, 0);
+#else
+	xTaskNotifyWait (
+	    0, UINT32_MAX, &events, pdMS_TO_TICKS (nextEventTimeout ()));
+#endif
+
+	lastWakeTime = micros ();
+	idleTimeUs += lastWakeTime - sleepStart;
+
+	if (events & EVENT_RX)
+		rxWakeups++;
+	if (events & EVENT_COMMAND)
+		commandWakeups++;
+	if (events == 0)
+		timerWakeups++;
+}
 
-	while (printerSerial->available ())
+GCodeDevice::TaskLoadStats GCodeDevice::getTaskLoadStats () const
+{
+	return TaskLoadStats{
+	    (uint32_t)(busyTimeUs / 1000),
+	    (uint32_t)(idleTimeUs / 1000),
+	    rxWakeups,
+	    commandWakeups,
+	    timerWakeups};
+}
+
+void GCodeDevice::sendCommands ()
+{
+	// bool loadedNewCmd=false;
+
+	if (xoffEnabled && xoff)
+		return;
+
+	if (!trySendRetransmits ())
 	{
-		char ch = (char)printerSerial->read ();
-		switch (ch)
-		{
-		case '\n':
-		case '\r':
+		flushTxBatch ();
+		return;
+	}
+
+	// Pack as many lines as the device can take into a single UART write
+	while (true)
+	{
+		Lane lane = nextLane ();
+
+		// Also happens when in panic and there are no realtime commands.
+		if (lane == LANE_COUNT)
 			break;
-		case XOFF:
-			if (xoffEnabled)
-			{
-				xoff = true;
+
+		LaneState& state = lanes[ lane ];
+		size_t     cost  = lineArena->Length (state.head) + 1;
+
+		if (!trySendCommand (state.head, lane))
+		{
+			// Device buffers larger than the batch: write the batch out and
+			// retry, otherwise the rest would wait for the next wakeup
+			if (txBatchLen == 0)
 				break;
-			}
-		case XON:
-			if (xoffEnabled)
-			{
-				xoff = false;
+			flushTxBatch ();
+			if (!trySendCommand (state.head, lane))
 				break;
-			}
-		default:
-			if (respLen < MAX_LINE)
-				resp[ respLen++ ] = ch;
 		}
-		if (ch == '\n')
-		{
-			resp[ respLen ] = 0;
+
+		accountLaneHead (lane);
+		state.sent++;
+		if (LANE_BUDGETS[ lane ].quantum != 0)
+			state.deficit -= cost;
+	}
+
+	flushTxBatch ();
+}
+
+bool GCodeDevice::appendTxBatch (const char* data, size_t len, bool newline)
+{
+	if (txBatchLen + len + (newline ? 1 : 0) > TX_BATCH_BYTES)
+		return false;
+	memcpy (txBatch + txBatchLen, data, len);
+	txBatchLen += len;
+	if (newline)
+		txBatch[ txBatchLen++ ] = '\n';
+	return true;
+}
+
+void GCodeDevice::flushTxBatch ()
+{
+	if (txBatchLen == 0)
+		return;
+	printerSerial->write (txBatch, txBatchLen);
+	txBatchLen = 0;
+}
+
+// Takes XON/XOFF out of received data, the last one seen wins
+static size_t stripFlowControl (char* data, size_t len, bool& xoff)
+{
+	if (!memchr (data, XOFF, len) && !memchr (data, XON, len))
+		return len;
+
+	size_t kept = 0;
+	for (size_t i = 0; i < len; i++)
+	{
+		if (data[ i ] == XOFF)
+			xoff = true;
+		else if (data[ i ] == XON)
+			xoff = false;
+		else
+			data[ kept++ ] = data[ i ];
+	}
+	return kept;
+}
+
+void GCodeDevice::receiveResponses ()
+{
+	int available;
+	while ((available = printerSerial->available ()) > 0)
+	{
+		// Drain the UART in blocks straight into the framer buffer
+		char*  data = responseFramer.WritePointer ();
+		size_t len  = min ((size_t)available, responseFramer.WriteSpace ());
+		len         = printerSerial->readBytes (data, len);
+		if (xoffEnabled)
+			len = stripFlowControl (data, len, xoff);
+		responseFramer.Commit (len);
+
+		responseFramer.ForEachLine ([ this ] (char* line, size_t lineLen) {
 			for (const auto& r : receivedLineHandlers)
 				if (r)
-					r (resp, respLen);
-			tryParseResponse (resp, respLen);
-			respLen = 0;
-		}
+					r (line, lineLen);
+			tryParseResponse (line, lineLen);
+		});
 	}
 }
 
 #define TEMP_COMMAND "M105"
 #define AUTOTEMP_COMMAND "M155 S"
+#define AUTOPOS_COMMAND "M154 S"
 
 bool startsWith (const char* str, const char* pre)
 {
 	return strncmp (pre, str, strlen (pre)) == 0;
 }
 
-void MarlinDevice::trySendCommand ()
+static bool isLineNumberError (const char* resp)
 {
-	char*   cmd = curUnsentPriorityCmdLen != 0 ? &curUnsentPriorityCmd[ 0 ]
-	                                           : &curUnsentCmd[ 0 ];
-	size_t* len = curUnsentPriorityCmdLen != 0 ? &curUnsentPriorityCmdLen
-	                                           : &curUnsentCmdLen;
+	return startsWith (resp, "Error:") && strstr (resp, "Last Line") != nullptr;
+}
 
-	if (sentCounter->canPush (*len))
+bool MarlinDevice::trySendCommand (LineHandle& line, Lane lane)
+{
+	if (lineChecksums)
 	{
-		sentCounter->push (cmd, *len);
-		printerSerial->write (cmd, *len);
-		printerSerial->print ('\n');
-		armRxTimeout ();
-		GD_DEBUGF (
-		    "<  (f%3d,%3d) '%s' (%d)\n",
-		    sentCounter->getFreeLines (),
-		    sentCounter->getFreeBytes (),
-		    cmd,
-		    *len);
-		*len = 0;
+		if (lineNumberResync)
+		{
+			// M110 is accepted with any line number and restarts numbering
+			nextLineNumber = 0;
+			if (!trySendNumberedLine (kNoLine))
+				return false;
+			lineNumberResync = false;
+		}
+		if (!trySendNumberedLine (line))
+			return false;
+		line = kNoLine;
+		return true;
 	}
-	else
+
+	char*  cmd = lineArena->Data (line);
+	size_t len = lineArena->Length (line);
+
+	// The slot stays allocated until the line is acknowledged, the response
+	// parser needs the command text.
+	if (!sentCounter->canPush (len) || !appendTxBatch (cmd, len, true))
 	{
 		// if(loadedNewCmd) GD_DEBUGF("<  Not sent, free lines: %d, free space:
 		// %d\n", sentQueue.getFreeLines() , sentQueue.getFreeBytes()  );
+		return false;
 	}
+
+	sentCounter->push (line, len);
+	armRxTimeout ();
+	GD_DEBUGF (
+	    "<  (f%3d,%3d) '%s' (%d)\n",
+	    sentCounter->getFreeLines (),
+	    sentCounter->getFreeBytes (),
+	    cmd,
+	    len);
+	line = kNoLine;
+	return true;
+}
+
+// Line number and checksum are added at send time only, the slot keeps the
+// plain command for the response parser and for resending
+size_t MarlinDevice::composeNumberedLine (
+    LineHandle line, uint32_t number, char* out, size_t size) const
+{
+	int len;
+	if (line == kNoLine)
+		len = snprintf (
+		    out,
+		    size,
+		    "N%lu M110 N%lu",
+		    (unsigned long)number,
+		    (unsigned long)number);
+	else
+	{
+		// Marlin strips comments before verifying the checksum
+		const char* cmd    = lineArena->Data (line);
+		int         cmdLen = strcspn (cmd, ";");
+		len = snprintf (
+		    out, size, "N%lu %.*s", (unsigned long)number, cmdLen, cmd);
+	}
+
+	uint8_t checksum = 0;
+	for (int i = 0; i < len; i++)
+		checksum ^= out[ i ];
+	len += snprintf (out + len, size - len, "*%u", checksum);
+	return len;
+}
+
+bool MarlinDevice::trySendNumberedLine (LineHandle line)
+{
+	char   out[ MAX_GCODE_LINE + 24 ];
+	size_t len = composeNumberedLine (line, nextLineNumber, out, sizeof (out));
+
+	if (!sentQueue.canPush (len) || !appendTxBatch (out, len, true))
+		return false;
+
+	sentQueue.push (line, len, nextLineNumber++);
+	armRxTimeout ();
+	GD_DEBUGF (
+	    "<  (f%3d,%3d) '%s' (%d)\n",
+	    sentQueue.getFreeLines (),
+	    sentQueue.getFreeBytes (),
+	    out,
+	    len);
+	return true;
+}
+
+bool MarlinDevice::trySendRetransmits ()
+{
+	while (resendIndex < sentQueue.size ())
+	{
+		char   out[ MAX_GCODE_LINE + 24 ];
+		size_t len = composeNumberedLine (
+		    sentQueue.lineAt (resendIndex),
+		    sentQueue.numberAt (resendIndex),
+		    out,
+		    sizeof (out));
+
+		// The printer dropped these lines, the bytes they were accounted with
+		// are free again for the same lines
+		if (!appendTxBatch (out, len, true))
+		{
+			flushTxBatch ();
+			if (!appendTxBatch (out, len, true))
+				return false;
+		}
+
+		GD_DEBUGF ("<  resend '%s'\n", out);
+		resendIndex++;
+		resendStats.resentLines++;
+		armRxTimeout ();
+	}
+
+	resendIndex = NO_RESEND;
+	return true;
+}
+
+// Marlin answers a corrupted or out of sequence line with
+//   Error:checksum mismatch, Last Line: 41
+//   Resend: 42
+//   ok
+// and drops whatever is in its RX buffer. Every line that was already on the
+// wire after the bad one gets the same answer.
+void MarlinDevice::requestResend (uint32_t number)
+{
+	resendStats.requests++;
+	pendingResendOks++;
+
+	if (number == resendLineNumber && ignoredResends > 0)
+	{
+		ignoredResends--;
+		resendStats.ignored++;
+		return;
+	}
+
+	size_t index = sentQueue.find (number);
+	if (index == sentQueue.size ())
+	{
+		if (number == nextLineNumber)
+			return; // nothing was lost
+
+		lastResponse = "Resend of a line no longer kept";
+		cleanupQueue ();
+		panic = true;
+		notify_observers (DeviceStatusEvent{1});
+		return;
+	}
+
+	resendIndex      = index;
+	resendLineNumber = number;
+	ignoredResends   = sentQueue.size () - index - 1;
 }
 
 void MarlinDevice::tryParseResponse (char* resp, size_t len)
 {
 
-	char   tmp = 0;
-	char*  curCmd;
-	size_t curCmdLen = sentQueue.peek (curCmd);
-	if (curCmdLen == 0)
-		curCmd = &tmp;
+	char       tmp     = 0;
+	LineHandle curLine = sentQueue.peek ();
+	char*      curCmd  = curLine != kNoLine ? lineArena->Data (curLine) : &tmp;
 
 	// GD_DEBUGF(" > '%s'; current cmd %s\n", resp, curCmd );
 
-	if (startsWith (resp, "ok"))
+	if (startsWith (resp, "ok") && pendingResendOks > 0)
+	{
+		// Closes a resend request, no line is acknowledged by it
+		pendingResendOks--;
+	}
+	else if (startsWith (resp, "ok"))
 	{
 
 		if (startsWith (curCmd, TEMP_COMMAND))
-			parseTemperatures (String (resp));
+		{
+			MarlinResponse response;
+			TokenizeMarlinResponse (etl::string_view{resp, len}, response);
+			parseTemperatures (response);
+		}
+		else if (startsWith (curCmd, "M115"))
+			negotiateAutoreports ();
 		else if (fwAutoreportTempCap && startsWith (curCmd, AUTOTEMP_COMMAND))
+		{
 			autoreportTempEnabled = (curCmd[ 6 ] != '0');
-		else if (startsWith (curCmd, "G0") || startsWith (curCmd, "G1"))
+			lastTempReportTime    = millis ();
+		}
+		else if (fwAutoreportPosCap && startsWith (curCmd, AUTOPOS_COMMAND))
 		{
-			parseG0G1 (curCmd); // artificial position from G0/G1 command
+			autoreportPosEnabled = (curCmd[ 6 ] != '0');
+			lastPosReportTime    = millis ();
 		}
+		else
+			trackMotion (curCmd);
+
+		// The resent line got through, later requests for it are genuine
+		if (sentQueue.size () > 0 && sentQueue.numberAt (0) == resendLineNumber)
+			ignoredResends = 0;
 
 		// sentQueue.markAcknowledged();     // Go on with next command
-		sentQueue.pop ();
+		acknowledgeLine ();
+		if (resendIndex != NO_RESEND && resendIndex > 0)
+			resendIndex--;
+		updateFlowWindow (resp);
 
 		// curCmdLen = 0; // need to fetch another sent command from queue
 
@@ -317,23 +797,32 @@ void MarlinDevice::tryParseResponse (char* resp, size_t len)
 	{
 		if (connected)
 		{
+			MarlinResponse response;
+			TokenizeMarlinResponse (etl::string_view{resp, len}, response);
+
 			if (startsWith (curCmd, "M115"))
 			{
-				parseM115 (String (resp));
+				parseM115 (etl::string_view{resp, len});
 			}
-			else if (parseTemperatures (String (resp)))
+			else if (parseTemperatures (response))
 			{
 				// do nothing
 				// sprintf(responseDetail, "autotemp");
 			}
-			else if (parsePosition (resp))
+			else if (parsePosition (response))
 			{
 				// do nothing
 				// sprintf(responseDetail, "position");
-				/*} else if (startsWith(resp, "Resend: ")) {
-				    nline = (int)extractFloat(resp, "Resend:");
-				    sprintf(responseDetail, "sync line=%d", nline);
-				}*/
+			}
+			else if (startsWith (resp, "Resend:"))
+			{
+				requestResend (strtoul (resp + 7, nullptr, 10));
+			}
+			else if (lineChecksums && isLineNumberError (resp))
+			{
+				// Resend request follows, the stream recovers by itself
+				lastResponse = resp;
+				resendStats.lineErrors++;
 			}
 			else if (startsWith (resp, "echo: cold extrusion prevented"))
 			{
@@ -373,141 +862,265 @@ void MarlinDevice::tryParseResponse (char* resp, size_t len)
 	updateRxTimeout (sentQueue.size () > 0);
 };
 
-// Parse temperatures from printer responses like
-// ok T:32.8 /0.0 B:31.8 /0.0 T0:32.8 /0.0 @:0 B@:0
-bool MarlinDevice::parseTemperatures (const String& response)
+void MarlinDevice::negotiateAutoreports ()
 {
-	bool ret;
+	autoreportSeconds =
+	    constrain ((getPollRates ().idle + 999) / 1000, 1, 60); // at most 60
+	char cmd[ 16 ];
+	if (fwAutoreportTempCap && !autoreportTempEnabled)
+	{
+		snprintf (cmd, sizeof (cmd), AUTOTEMP_COMMAND "%u", autoreportSeconds);
+		schedulePriorityCommand (cmd);
+	}
+	if (fwAutoreportPosCap && !autoreportPosEnabled)
+	{
+		snprintf (cmd, sizeof (cmd), AUTOPOS_COMMAND "%u", autoreportSeconds);
+		schedulePriorityCommand (cmd);
+	}
+}
 
-	if (fwExtruders == 1)
-		ret = parseTemp (response, "T", &toolTemperatures[ 0 ]);
-	else
+void MarlinDevice::checkAutoreports ()
+{
+	uint32_t now     = millis ();
+	uint32_t timeout = autoreportSeconds * 1000u * AUTOREPORT_TIMEOUT_FACTOR;
+	bool     stale   = false;
+	if (autoreportTempEnabled && now - lastTempReportTime > timeout)
 	{
-		ret = false;
-		for (int t = 0; t < fwExtruders; t++)
-			ret |=
-			    parseTemp (response, "T" + String (t), &toolTemperatures[ t ]);
+		autoreportTempEnabled = false;
+		stale                 = true;
 	}
-	ret |= parseTemp (response, "B", &bedTemperature);
-	if (!ret)
+	if (autoreportPosEnabled && now - lastPosReportTime > timeout)
+	{
+		autoreportPosEnabled = false;
+		stale                = true;
+	}
+	if (stale)
 	{
-		// Parse Prusa heating temperatures
-		int e = extractPrusaHeatingExtruder (response);
-		ret   = e >= 0 && e < MAX_SUPPORTED_EXTRUDERS &&
-		    extractPrusaHeatingTemp (
-		          response, "T", toolTemperatures[ e ].actual);
-		ret |= extractPrusaHeatingTemp (response, "B", bedTemperature.actual);
+		GD_DEBUGS ("Autoreports stopped, polling");
+		negotiateAutoreports ();
 	}
+}
 
-	if (ret)
-		GD_DEBUGF (
-		    "Parsed temp E:%d->%d  B:%d->%d\n",
-		    (int)toolTemperatures[ 0 ].actual,
-		    (int)toolTemperatures[ 0 ].target,
-		    (int)bedTemperature.actual,
-		    (int)bedTemperature.target);
+void MarlinDevice::sampleTemperatureHistory ()
+{
+	const uint32_t period = TemperatureHistory::kSamplePeriodMs;
 
-	notify_observers (DeviceStatusEvent{0});
+	uint32_t now = millis ();
+	if (lastTempReportTime == 0)
+		return; // nothing read yet
+	if (nextHistorySampleTime == 0)
+		nextHistorySampleTime = now;
+	if ((int32_t)(now - nextHistorySampleTime) < 0)
+		return;
 
-	return ret;
+	// Periods the device task was too busy for take the same readings
+	uint32_t periods = 1 + (now - nextHistorySampleTime) / period;
+	nextHistorySampleTime += periods * period;
+	periods = min (periods, (uint32_t)TemperatureHistory::kFineCount);
+
+	bool fresh = now - lastTempReportTime <=
+	    autoreportSeconds * 1000u * AUTOREPORT_TIMEOUT_FACTOR;
+
+	for (uint32_t i = 0; i < periods; i++)
+	{
+		for (int t = 0; t < fwExtruders; t++)
+			toolHistory[ t ].Add (
+			    fresh ? TemperatureSample::FromCelsius (
+			                toolTemperatures[ t ].actual,
+			                toolTemperatures[ t ].target)
+			          : TemperatureSample{});
+		bedHistory.Add (
+		    fresh ? TemperatureSample::FromCelsius (
+		                bedTemperature.actual, bedTemperature.target)
+		          : TemperatureSample{});
+	}
+}
+
+void MarlinDevice::updateFlowWindow (const char* resp)
+{
+	const char* p = strstr (resp, " P");
+	const char* b = strstr (resp, " B");
+	if (p == nullptr || b == nullptr || !isDigit (p[ 2 ]) || !isDigit (b[ 2 ]))
+		return; // no ADVANCED_OK, keep the fixed window
+
+	int plannerFree = atoi (p + 2);
+	int bufferFree  = atoi (b + 2);
+
+	// ok is sent while the command still holds its buffer slot, so the idle
+	// printer reports one less than its buffer size
+	if (bufferFree + 1 > flowStats.commandBufferSize)
+		flowStats.commandBufferSize = min (bufferFree + 1, 255);
+
+	// Commands left in the printer buffer are the oldest unacknowledged ones,
+	// they no longer take printer RX buffer space
+	int buffered = (int)flowStats.commandBufferSize - 1 - bufferFree;
+	if (buffered > 0)
+		sentQueue.markDrained (buffered);
+
+	size_t window = sentQueue.getLineLimit ();
+	if (bufferFree > 0 && plannerFree > 0)
+		window++; // printer has room, let more lines in flight
+	else if (
+	    bufferFree == 0 && plannerFree == 0 &&
+	    window > max ((size_t)flowStats.commandBufferSize, MIN_SENT_LINES))
+		window--; // both full, extra lines would only wait in RX buffer
+	sentQueue.setLineLimit (window);
+	window = sentQueue.getLineLimit ();
+
+	if (flowStats.windowSamples == 0)
+		flowStats.minWindow = flowStats.maxWindow = window;
+	flowStats.window      = window;
+	flowStats.minWindow   = min ((size_t)flowStats.minWindow, window);
+	flowStats.maxWindow   = max ((size_t)flowStats.maxWindow, window);
+	flowStats.plannerFree = min (plannerFree, 255);
+	flowStats.bufferFree  = min (bufferFree, 255);
+	flowStats.windowSum += window;
+	flowStats.windowSamples++;
+
+	if (millis () > nextFlowSampleTime)
+	{
+		flowHistory.push (window);
+		nextFlowSampleTime = millis () + 1000;
+	}
 }
 
-// parses line T:aaa.aa /ttt.tt
-bool MarlinDevice::parseTemp (
-    const String& response, const String whichTemp, Temperature* temperature)
+// Parse temperatures from printer responses like
+// ok T:32.8 /0.0 B:31.8 /0.0 T0:32.8 /0.0 @:0 B@:0
+// or from Prusa firmware while heating, without targets
+// T:32.8 E:0 B:31.8
+bool MarlinDevice::parseTemperatures (const MarlinResponse& response)
 {
-	int tpos = response.indexOf (whichTemp + ":");
-	if (tpos != -1)
-	{ // This response contains a temperature
-		int slashpos = response.indexOf (" /", tpos);
-		int spacepos = response.indexOf (" ", slashpos + 1);
-		// if match mask T:xxx.xx /xxx.xx
-		if (slashpos != -1 && spacepos != -1)
+	bool ret = false;
+
+	if (fwExtruders == 1)
+	{
+		if (response.fields & kMarlinToolTarget)
 		{
-			String actual =
-			    response.substring (tpos + whichTemp.length () + 1, slashpos);
-			String target = response.substring (slashpos + 2, spacepos);
-			if (isFloat (actual) && isFloat (target))
+			toolTemperatures[ 0 ] = {
+			    response.tool.actual, response.tool.target};
+			ret = true;
+		}
+	}
+	else
+	{
+		for (int t = 0; t < fwExtruders; t++)
+			if (response.tools_targets & (1 << t))
 			{
-				temperature->actual = actual.toFloat ();
-				temperature->target = target.toFloat ();
-
-				return true;
+				toolTemperatures[ t ] = {
+				    response.tools[ t ].actual, response.tools[ t ].target};
+				ret = true;
 			}
+	}
+	if (response.fields & kMarlinBedTarget)
+	{
+		bedTemperature = {response.bed.actual, response.bed.target};
+		ret            = true;
+	}
+	if (!ret)
+	{
+		// Prusa heating temperatures, E: is the extruder heated
+		int e = (response.fields & kMarlinE) ? (int)response.position[ 3 ] : -1;
+		if (e >= 0 && e < MAX_SUPPORTED_EXTRUDERS &&
+		    (response.fields & kMarlinTool))
+		{
+			toolTemperatures[ e ].actual = response.tool.actual;
+			ret                          = true;
+		}
+		if (response.fields & kMarlinBed)
+		{
+			bedTemperature.actual = response.bed.actual;
+			ret                   = true;
 		}
 	}
 
-	return false;
+	if (!ret)
+		return false;
+
+	lastTempReportTime = millis ();
+	statusQueryAnswered (QUERY_TEMPERATURE);
+	sampleTemperatureHistory ();
+	GD_DEBUGF (
+	    "Parsed temp E:%d->%d  B:%d->%d\n",
+	    (int)toolTemperatures[ 0 ].actual,
+	    (int)toolTemperatures[ 0 ].target,
+	    (int)bedTemperature.actual,
+	    (int)bedTemperature.target);
+
+	notify_observers (DeviceStatusEvent{0});
+
+	return true;
 }
 
 // Parse position responses from printer like
 // X:-33.00 Y:-10.00 Z:5.00 E:37.95 Count X:-3300 Y:-1000 Z:2000
-bool MarlinDevice::parsePosition (const char* str)
+bool MarlinDevice::parsePosition (const MarlinResponse& response)
 {
-	float t = extractFloat (str, "X:");
-	if (!isnan (t))
-		x = t;
-	else
-		return false;
-	t = extractFloat (str, "Y:");
-	if (!isnan (t))
-		y = t;
-	else
-		return false;
-	t = extractFloat (str, "Z:");
-	if (!isnan (t))
-		z = t;
-	else
-		return false;
-	t = extractFloat (str, "E:");
-	if (!isnan (t))
-		ePos = t;
-	else
+	const uint16_t axes = kMarlinX | kMarlinY | kMarlinZ | kMarlinE;
+	if ((response.fields & axes) != axes)
 		return false;
+	x    = response.position[ 0 ];
+	y    = response.position[ 1 ];
+	z    = response.position[ 2 ];
+	ePos = response.position[ 3 ];
+	for (int axis = 0; axis < kMarlinAxisCount; axis++)
+		motion.position[ axis ] = response.position[ axis ];
+	motion.known = kMarlinAllAxes;
 	GD_DEBUGF ("Parsed pos: X: %f, Y: %f, Z: %f, E: %f\n", x, y, z, ePos);
+	lastPosReportTime = millis ();
+	statusQueryAnswered (QUERY_POSITION);
 	notify_observers (DeviceStatusEvent{0});
 	return true;
 }
 
-// Parse position responses from printer like
-// X:-33.00 Y:-10.00 Z:5.00 E:37.95 Count X:-3300 Y:-1000 Z:2000
-bool MarlinDevice::parseG0G1 (const char* str)
+void MarlinDevice::trackMotion (const char* cmd)
 {
-	float t = extractFloat (str, "X");
-	if (!isnan (t))
-		x = t;
-	else
-		return false;
-	t = extractFloat (str, "Y");
-	if (!isnan (t))
-		y = t;
-	else
-		return false;
-	t = extractFloat (str, "Z");
-	if (!isnan (t))
-		z = t;
-	else
-		return false;
-	t = extractFloat (str, "E");
-	if (!isnan (t))
-		ePos = t;
-	else
-		return false;
-	GD_DEBUGF ("Parsed pos: X: %f, Y: %f, Z: %f, E: %f\n", x, y, z, ePos);
+	uint8_t changed = ApplyMarlinMotionLine (etl::string_view{cmd}, motion);
+	if (changed == 0)
+		return;
+
+	// Unknown axes keep the last value until M114 tells
+	float* const axes[] = {&x, &y, &z, &ePos};
+	for (int axis = 0; axis < kMarlinAxisCount; axis++)
+		if (changed & motion.known & (1 << axis))
+			*axes[ axis ] = motion.position[ axis ];
+	GD_DEBUGF (
+	    "Tracked pos: X: %f, Y: %f, Z: %f, E: %f, known %x\n",
+	    x,
+	    y,
+	    z,
+	    ePos,
+	    motion.known);
 	notify_observers (DeviceStatusEvent{0});
-	return true;
 }
 
-bool MarlinDevice::parseM115 (const String& str)
+bool MarlinDevice::parseM115 (etl::string_view reply)
 {
-	desc = extractM115String (str, "FIRMWARE_NAME") + " " +
-	    extractM115String (str, "MACHINE_TYPE");
-	String value = extractM115String (str, "EXTRUDER_COUNT");
-	fwExtruders =
-	    value == "" ? 1 : min (value.toInt (), (long)MAX_SUPPORTED_EXTRUDERS);
-	fwAutoreportTempCap = extractM115Bool (str, "Cap:AUTOREPORT_TEMP");
-	fwProgressCap       = extractM115Bool (str, "Cap:PROGRESS");
-	fwBuildPercentCap   = extractM115Bool (str, "Cap:BUILD_PERCENT");
+	etl::string_view name = FindMarlinM115Field (reply, "FIRMWARE_NAME");
+	if (!name.empty ())
+	{
+		etl::string_view type = FindMarlinM115Field (reply, "MACHINE_TYPE");
+		desc = String (name.data (), name.size ()) + " " +
+		    String (type.data (), type.size ());
+	}
+
+	// The value ends at a space or at the end of the response
+	etl::string_view extruders = FindMarlinM115Field (reply, "EXTRUDER_COUNT");
+	if (!extruders.empty ())
+		fwExtruders = constrain (
+		    strtol (extruders.data (), nullptr, 10),
+		    1L,
+		    (long)MAX_SUPPORTED_EXTRUDERS);
+
+	auto updateCap = [ reply ] (const char* key, bool& cap) {
+		etl::string_view value = FindMarlinM115Field (reply, key);
+		if (!value.empty ())
+			cap = value == "1";
+	};
+	updateCap ("Cap:AUTOREPORT_TEMP", fwAutoreportTempCap);
+	updateCap ("Cap:AUTOREPORT_POS", fwAutoreportPosCap);
+	updateCap ("Cap:PROGRESS", fwProgressCap);
+	updateCap ("Cap:BUILD_PERCENT", fwBuildPercentCap);
+
 	GD_DEBUGF (
 	    "Parsed M115: desc=%s, extruders:%d, autotemp:%d, progress:%d, "
 	    "buildPercent:%d\n",
@@ -519,93 +1132,3 @@ bool MarlinDevice::parseM115 (const String& str)
 	notify_observers (DeviceStatusEvent{0});
 	return true;
 }
-
-bool MarlinDevice::isFloat (const String value)
-{
-	for (int i = 0; i < value.length (); i++)
-	{
-		char ch = value[ i ];
-		if (ch != ' ' && ch != '.' && ch != '-' && !isDigit (ch))
-			return false;
-	}
-	return true;
-}
-
-inline float MarlinDevice::extractFloat (const char* str, const char* key)
-{
-	char* s = strstr (str, key);
-	if (s == NULL)
-		return NAN;
-	s += strlen (key);
-	return atof (s);
-}
-
-inline float MarlinDevice::extractFloat (const String& str, const String key)
-{
-	int s = str.indexOf (key);
-	if (s == -1)
-		return NAN;
-	s += key.length ();
-	int e = str.indexOf (' ', s);
-	if (e == -1)
-		e = str.length ();
-	return str.substring (s, e).toFloat ();
-}
-
-// Parse temperatures from prusa firmare (sent when heating)
-// ok T:32.8 E:0 B:31.8
-bool MarlinDevice::extractPrusaHeatingTemp (
-    const String& response, const String whichTemp, float& temperature)
-{
-	int tpos = response.indexOf (whichTemp + ":");
-	if (tpos != -1)
-	{ // This response contains a temperature
-		int spacepos = response.indexOf (" ", tpos);
-		if (spacepos == -1)
-			spacepos = response.length ();
-		String actual =
-		    response.substring (tpos + whichTemp.length () + 1, spacepos);
-		if (isFloat (actual))
-		{
-			temperature = actual.toFloat ();
-			return true;
-		}
-	}
-
-	return false;
-}
-
-inline int MarlinDevice::extractPrusaHeatingExtruder (const String& response)
-{
-	float tmp;
-	return extractPrusaHeatingTemp (response, "E", tmp) ? (int)tmp : -1;
-}
-
-String
-    MarlinDevice::extractM115String (const String& response, const String key)
-{
-	int spos = response.indexOf (key + ":");
-	if (spos != -1)
-	{
-		spos += key.length () + 1;
-		int epos = response.indexOf (':', spos);
-		if (epos == -1)
-			return response.substring (spos);
-		else
-		{
-			while (epos >= spos && response[ epos ] != ' ' &&
-			       response[ epos ] != '\n')
-				--epos;
-			return response.substring (spos, epos);
-		}
-	}
-
-	return "";
-}
-
-inline bool MarlinDevice::extractM115Bool (
-    const String& response, const String key, const bool onErrorValue)
-{
-	String result = extractM115String (response, key);
-	return result == "" ? onErrorValue : (result == "1" ? true : false);
-}
@@ -1,13 +1,24 @@
 #pragma once
 
 #include <Arduino.h>
+#include <etl/circular_buffer.h>
 #include <etl/observer.h>
+#include <etl/atomic.h>
 // #include <etl/queue.h>
 #include "CommandQueue.h"
-#include <message_buffer.h>
+#include "LineArena.hpp"
+#include "MpscQueue.hpp"
+#include "ResponseFramer.hpp"
+#include "MarlinMotion.hpp"
+#include "MarlinResponse.hpp"
+#include "TemperatureHistory.hpp"
 
 // #define ADD_LINECOMMENTS
 
+// Spin in the device task instead of blocking on notifications, e.g. to
+// compare task load
+// #define DEVICE_TASK_POLLING
+
 #define GD_DEBUGF(...) // { Serial.printf(__VA_ARGS__); }
 #define GD_DEBUGS(s)   // { Serial.println(s); }
 #define GD_DEBUGLN GD_DEBUGS
@@ -15,9 +26,28 @@
 #define KEEPALIVE_INTERVAL                                                     \
 	5000 // Marlin defaults to 2 seconds, get a little of margin
 
-#define STATUS_REQUEST_INTERVAL 500
+// Status polling is never faster than this many reply round trips
+#define STATUS_POLL_LATENCY_FACTOR 2
+
+// Round trips above this are counted as this, a lost reply must not stop
+// polling
+#define STATUS_LATENCY_MAX 1000
+
+// An unanswered status query is given up after this, its reply was lost
+#define STATUS_QUERY_TIMEOUT 10000
+
+// Upper bound of the device task sleep when nothing wakes it up
+#define DEVICE_EVENT_WAIT_MAX 100
 
-const int MAX_DEVICE_OBSERVERS = 4;
+// Autoreports missing for this many intervals are asked for again, and the
+// values polled meanwhile
+#define AUTOREPORT_TIMEOUT_FACTOR 5
+
+// Marlin position tracked from the lines sent is checked with M114 this
+// often, in case the printer moved by itself
+#define POSITION_RESYNC_TIME 10000
+
+const int MAX_DEVICE_OBSERVERS = 5;
 struct DeviceStatusEvent {
 	int statusField;
 };
@@ -31,23 +61,10 @@ public:
 	static GCodeDevice* getDevice ();
 	// static void setDevice(GCodeDevice *dev);
 
-	GCodeDevice (Stream* s, size_t priorityBufSize = 0, size_t bufSize = 0)
+	GCodeDevice (Stream* s)
 	    : printerSerial (s)
 	    , connected (false)
 	{
-		if (priorityBufSize != 0)
-		{
-			priority_buf = xMessageBufferCreate (priorityBufSize);
-		}
-
-		if (bufSize != 0)
-		{
-			regular_buf = xMessageBufferCreate (bufSize);
-		}
-
-		priority_buf_len = priorityBufSize;
-		regular_buf_len  = bufSize;
-
 		assert (inst == nullptr);
 		inst = this;
 	}
@@ -65,23 +82,125 @@ public:
 	{
 		while (printerSerial->available () > 0)
 			printerSerial->read ();
+		responseFramer.Clear ();
 		connected = true;
 	};
 
+	/**
+	 * Scheduler lanes. Realtime and jog lanes are served in strict priority
+	 * order, interactive and job lanes share what is left by weighted fair
+	 * queuing on bytes. Only the realtime lane is served in panic.
+	 */
+	enum Lane : uint8_t {
+		LANE_REALTIME,    ///< Realtime bytes, resets, status requests
+		LANE_JOG,         ///< Pendant jog moves
+		LANE_INTERACTIVE, ///< UI and web commands
+		LANE_JOB,         ///< Lines of the running job
+		LANE_COUNT
+	};
+
+	/// Outcome of a submission; anything but OK means the line was not taken
+	enum class SubmitResult : uint8_t {
+		OK,
+		PANIC,     ///< Device is in panic, only realtime lines are taken
+		EMPTY,     ///< Nothing to send
+		NO_SLOTS,  ///< Line arena exhausted, retry later
+		LANE_FULL, ///< Lane line or byte budget exhausted, retry later
+	};
+
+	struct SubmitStats {
+		uint32_t accepted;
+		uint32_t panic;
+		uint32_t noSlots;
+		uint32_t laneFull;
+	};
+
+	struct LaneStats {
+		uint16_t lines;    ///< Queued, not sent yet
+		uint16_t bytes;    ///< Queued, not sent yet
+		uint16_t maxLines; ///< Highest queue depth seen
+		uint32_t sent;     ///< Lines sent from the lane
+		uint32_t refused;  ///< Submissions over the lane budget
+	};
+
+	/// How busy the machine is, selects the status poll interval
+	enum PollActivity : uint8_t {
+		POLL_IDLE,
+		POLL_ACTIVE, ///< Moving or streaming, the position changes quickly
+		POLL_ALARM,  ///< Nothing changes until the user steps in
+		POLL_ACTIVITY_COUNT
+	};
+
+	/// Status poll intervals in ms
+	struct PollRates {
+		uint16_t idle   = 500;
+		uint16_t active = 100;
+		uint16_t alarm  = 1000;
+	};
+
+	/// Status queries, at most one of each kind is unanswered at a time
+	enum StatusQuery : uint8_t {
+		QUERY_POSITION,    ///< Grbl ?, Marlin M114
+		QUERY_TEMPERATURE, ///< Marlin M105
+		QUERY_COUNT
+	};
+
+	struct StatusQueryStats {
+		uint32_t sent;
+		uint32_t skipped; ///< Not sent, the previous query was unanswered
+		uint32_t expired; ///< Given up on after STATUS_QUERY_TIMEOUT
+		uint32_t rttMs;   ///< Smoothed round trip, 0 until measured
+	};
+
+	/**
+	 * Schedules a line from any task. Lines submitted by one task to one lane
+	 * are sent in the order they were submitted; lines of different tasks
+	 * are never mixed, each line is copied whole into its own slot. The
+	 * origin goes with the line, so errors can be traced back to it.
+	 */
+	SubmitResult submitCommand (
+	    const char*       cmd,
+	    size_t            len,
+	    Lane              lane   = LANE_INTERACTIVE,
+	    const LineOrigin& origin = LineOrigin{});
+
+	SubmitResult submitPriorityCommand (const char* cmd, size_t len)
+	{
+		return submitCommand (cmd, len, LANE_REALTIME);
+	}
+
+	SubmitStats getSubmitStats () const
+	{
+		return SubmitStats{
+		    submitCounts[ (int)SubmitResult::OK ].load (),
+		    submitCounts[ (int)SubmitResult::PANIC ].load (),
+		    submitCounts[ (int)SubmitResult::NO_SLOTS ].load (),
+		    submitCounts[ (int)SubmitResult::LANE_FULL ].load ()};
+	}
+
+	LaneStats getLaneStats (Lane lane) const;
+
+	static const char* getLaneName (Lane lane);
+
 	virtual bool scheduleCommand (String cmd)
 	{
 		return scheduleCommand (cmd.c_str (), cmd.length ());
 	};
 	virtual bool scheduleCommand (const char* cmd, size_t len)
 	{
-		if (panic)
-			return false;
-		if (!regular_buf)
-			return false;
-		if (len == 0)
-			return false;
-		return xMessageBufferSend (regular_buf, cmd, len, 0) != 0;
+		return submitCommand (cmd, len) == SubmitResult::OK;
 	};
+	/**
+	 * Schedules a pendant line that only sets modes. Devices that track the
+	 * modes drop it if they are set already.
+	 */
+	bool scheduleModeCommand (const char* cmd)
+	{
+		LineOrigin origin;
+		origin.modes_only = true;
+		return submitCommand (cmd, strlen (cmd), LANE_INTERACTIVE, origin) ==
+		    SubmitResult::OK;
+	}
 	virtual bool schedulePriorityCommand (String cmd)
 	{
 		return schedulePriorityCommand (cmd.c_str (), cmd.length ());
@@ -89,22 +208,9 @@ public:
 	virtual bool schedulePriorityCommand (const char* cmd, size_t len)
 	{
 		// if(panic) return false;
-		if (!priority_buf)
-			return false;
-		if (len == 0)
-			return false;
-		return xMessageBufferSend (priority_buf, cmd, len, 0) != 0;
-	}
-	virtual bool canSchedule (size_t len)
-	{
-		if (panic)
-			return false;
-		if (!regular_buf)
-			return false;
-		if (len == 0)
-			return false;
-		return xMessageBufferSpaceAvailable (regular_buf) > len + 2;
+		return submitPriorityCommand (cmd, len) == SubmitResult::OK;
 	}
+	virtual bool canSchedule (size_t len, Lane lane = LANE_INTERACTIVE);
 
 	virtual bool jog (uint8_t axis, float dist, int feed = 100) = 0;
 
@@ -113,17 +219,58 @@ public:
 		return true;
 	}
 
+	/// Device task events, delivered as task notification bits
+	enum Event : uint32_t {
+		EVENT_RX      = 1 << 0, ///< UART received data (also XON/XOFF)
+		EVENT_COMMAND = 1 << 1, ///< A command was scheduled
+	};
+
+	struct TaskLoadStats {
+		uint32_t busyMs;
+		uint32_t idleMs;
+		uint32_t rxWakeups;
+		uint32_t commandWakeups;
+		uint32_t timerWakeups;
+	};
+
+	/// Makes the device wake up the given task when something needs handling
+	void attachTask (TaskHandle_t task)
+	{
+		deviceTask   = task;
+		lastWakeTime = micros ();
+	}
+
+	/// Safe to call from any task, but not from an ISR
+	void notifyEvent (Event e)
+	{
+		if (deviceTask)
+			xTaskNotify (deviceTask, e, eSetBits);
+	}
+
+	/**
+	 * Blocks the device task until an event arrives or a timed action (status
+	 * request, RX timeout) is due. Accounts the busy and idle time.
+	 */
+	void waitForEvent ();
+
+	TaskLoadStats getTaskLoadStats () const;
+
+	/// Responses longer than MAX_RESPONSE_LINE, handed out truncated
+	uint32_t getOverflowedResponses () const
+	{
+		return responseFramer.OverflowedLines ();
+	}
+
 	virtual void loop ()
 	{
-		sendCommands ();
+		if (cleanupRequested.exchange (false))
+			cleanupRegularLines ();
+
+		// Receive first: acknowledgements free room for sending
 		receiveResponses ();
+		sendCommands ();
 		checkTimeout ();
-
-		if (nextStatusRequestTime != 0 && millis () > nextStatusRequestTime)
-		{
-			requestStatusUpdate ();
-			nextStatusRequestTime = millis () + STATUS_REQUEST_INTERVAL;
-		}
+		pollStatus ();
 	}
 	virtual void sendCommands ();
 	virtual void receiveResponses ();
@@ -153,12 +300,55 @@ public:
 		return panic;
 	}
 
+	/// Before begin() or from the device task
+	void setPollRates (const PollRates& rates)
+	{
+		pollRates = rates;
+	}
+
+	const PollRates& getPollRates () const
+	{
+		return pollRates;
+	}
+
+	/// Smoothed position query round trip in ms, 0 until measured
+	uint32_t getStatusLatency () const
+	{
+		return statusQueries[ QUERY_POSITION ].rttMs;
+	}
+
+	StatusQueryStats getStatusQueryStats (StatusQuery query) const
+	{
+		const StatusQueryState& state = statusQueries[ query ];
+		return {
+		    state.sent.load (),
+		    state.skipped.load (),
+		    state.expired.load (),
+		    state.rttMs};
+	}
+
+	static const char* getStatusQueryName (StatusQuery query);
+
+	/// Interval used for the last status request
+	uint32_t getPollInterval () const
+	{
+		return pollInterval;
+	}
+
+	PollActivity getPollActivity () const
+	{
+		return lastPollActivity;
+	}
+
+	static const char* getPollActivityName (PollActivity activity);
+
 	virtual void enableStatusUpdates (bool v = true)
 	{
 		if (v)
 			nextStatusRequestTime = millis ();
 		else
 			nextStatusRequestTime = 0;
+		notifyEvent (EVENT_COMMAND);
 	}
 
 	String getType ()
@@ -173,9 +363,10 @@ public:
 
 	size_t getQueueLength ()
 	{
-		return (priority_buf_len -
-		        xMessageBufferSpaceAvailable (priority_buf)) +
-		    (regular_buf_len - xMessageBufferSpaceAvailable (regular_buf));
+		size_t lines = 0;
+		for (const auto& state : lanes)
+			lines += state.lines.load ();
+		return lines;
 	}
 
 	size_t getSentQueueLength ()
@@ -197,24 +388,50 @@ protected:
 	bool     connected;
 	String   desc;
 	String   typeStr;
-	size_t   priority_buf_len, regular_buf_len;
 	bool     canTimeout;
 
-	static const size_t MAX_GCODE_LINE = 96;
-	char                curUnsentCmd[ MAX_GCODE_LINE + 1 ],
-	    curUnsentPriorityCmd[ MAX_GCODE_LINE + 1 ];
-	size_t curUnsentCmdLen, curUnsentPriorityCmdLen;
+	static const size_t MAX_GCODE_LINE    = 96;
+	static const size_t MAX_RESPONSE_LINE = 200; // M115 is far longer than 100
+
+	static const size_t LANE_CAPACITY = 16; ///< Upper bound of lane budgets
+
+	/// What a lane may hold before submissions are refused
+	struct LaneBudget {
+		uint8_t  lines;
+		uint16_t bytes;
+		uint8_t  slotReserve; ///< Arena slots left to the lanes above
+		uint16_t quantum;     ///< Fair share in bytes, 0 for strict lanes
+	};
+
+	static const LaneBudget LANE_BUDGETS[ LANE_COUNT ];
+
+	// Filled from the web server, UI and device tasks, drained by the device
+	// task only
+	struct LaneState {
+		MpscQueue< LineHandle, LANE_CAPACITY > queue;
+
+		LineHandle              head      = kNoLine; ///< Next line to send
+		uint8_t                 headBytes = 0;
+		etl::atomic< uint16_t > lines{0};
+		etl::atomic< uint16_t > bytes{0};
+		etl::atomic< uint16_t > maxLines{0};
+		etl::atomic< uint32_t > refused{0};
+		uint32_t                sent    = 0;
+		int32_t                 deficit = 0;
+	};
 
-	float                 x, y, z;
-	bool                  panic = false;
-	uint32_t              nextStatusRequestTime;
-	MessageBufferHandle_t priority_buf = nullptr;
-	MessageBufferHandle_t regular_buf  = nullptr;
+	float        x, y, z;
+	bool         panic = false;
+	uint32_t     nextStatusRequestTime = 0; ///< 0 with status updates off
+	LaneState    lanes[ LANE_COUNT ];
 
 	bool xoff;
 	bool xoffEnabled = false;
 
-	Counter* sentCounter;
+	ResponseFramer< MAX_RESPONSE_LINE > responseFramer;
+
+	LineArena* lineArena = nullptr;
+	Counter*   sentCounter;
 
 	void armRxTimeout ()
 	{
@@ -260,21 +477,157 @@ protected:
 		}
 	}
 
+	SubmitResult countSubmit (SubmitResult result)
+	{
+		submitCounts[ (int)result ].fetch_add (1, etl::memory_order_relaxed);
+		return result;
+	}
+
+	size_t getLaneFreeLines (Lane lane) const
+	{
+		size_t lines = lanes[ lane ].lines.load ();
+		return lines < LANE_BUDGETS[ lane ].lines
+		    ? LANE_BUDGETS[ lane ].lines - lines
+		    : 0;
+	}
+
+	/// Device task only: next line of the lane, kNoLine if there is none
+	LineHandle laneHead (Lane lane);
+
+	/// Device task only: takes the head off the lane budget
+	void accountLaneHead (Lane lane);
+
+	void dropLane (Lane lane);
+
+	/// Pops the oldest sent line, releasing its slot if the counter kept one
+	void acknowledgeLine ()
+	{
+		lineArena->Release (sentCounter->pop ());
+	}
+
+	/// Device task only, other tasks use requestCleanup()
 	void cleanupQueue ()
 	{
-		if (regular_buf)
-			xMessageBufferReset (regular_buf);
-		if (priority_buf)
-			xMessageBufferReset (priority_buf);
-		sentCounter->clear ();
-		curUnsentCmdLen = 0;
+		dropLane (LANE_REALTIME);
+		cleanupRegularLines ();
 	}
 
-	virtual void trySendCommand () = 0;
+	/**
+	 * Safe from any task: the device task drops all but realtime lines before
+	 * it sends anything else. Realtime lines are kept, so a reset command
+	 * scheduled right after the request still goes out.
+	 */
+	void requestCleanup ()
+	{
+		cleanupRequested.store (true);
+		notifyEvent (EVENT_COMMAND);
+	}
+
+	virtual void cleanupRegularLines ()
+	{
+		dropLane (LANE_JOG);
+		dropLane (LANE_INTERACTIVE);
+		dropLane (LANE_JOB);
+		while (sentCounter->size () > 0)
+			acknowledgeLine ();
+		// Replies still on the way no longer count as answers
+		for (auto& state : statusQueries)
+			state.issuedAt.store (0);
+	}
+
+	static const size_t TX_BATCH_BYTES = 128; // ESP32 UART hardware FIFO size
+
+	char   txBatch[ TX_BATCH_BYTES ];
+	size_t txBatchLen = 0;
+
+	/// Appends data to the pending UART write; false if it does not fit
+	bool appendTxBatch (const char* data, size_t len, bool newline);
+
+	void flushTxBatch ();
+
+	/**
+	 * Accounts for the line and appends it to the pending UART write.
+	 *
+	 * @return true and sets line to kNoLine if the line was taken, false if
+	 * the device can't take more data in this pass.
+	 */
+	virtual bool trySendCommand (LineHandle& line, Lane lane) = 0;
+
+	/**
+	 * Appends lines the device asked for once more, they go before any new
+	 * line.
+	 *
+	 * @return false if some of them are still waiting to be sent.
+	 */
+	virtual bool trySendRetransmits ()
+	{
+		return true;
+	}
 
 	virtual void tryParseResponse (char* cmd, size_t len) = 0;
 
+	/// Time until the device has something to do on its own, in ms
+	virtual uint32_t nextActionDelay ()
+	{
+		return DEVICE_EVENT_WAIT_MAX;
+	}
+
+	/// Default: busy while lines are queued or unacknowledged
+	virtual PollActivity pollActivity ();
+
+	/**
+	 * Claims a query before it is sent, from any task. False while an earlier
+	 * query of the kind is unanswered; the new one is skipped then, sending
+	 * it would only take room in the queues.
+	 */
+	bool beginStatusQuery (StatusQuery query);
+
+	/// The claimed query could not be scheduled
+	void cancelStatusQuery (StatusQuery query);
+
+	/// Device task, when the reply arrives
+	void statusQueryAnswered (StatusQuery query);
+
 private:
+	TaskHandle_t deviceTask = nullptr;
+
+	uint32_t lastWakeTime;
+	uint64_t busyTimeUs, idleTimeUs;
+	uint32_t rxWakeups, commandWakeups, timerWakeups;
+
+	static const size_t SUBMIT_RESULT_COUNT = (int)SubmitResult::LANE_FULL + 1;
+
+	etl::atomic< bool >     cleanupRequested{false};
+	etl::atomic< uint32_t > submitCounts[ SUBMIT_RESULT_COUNT ] = {};
+
+	void addLineComment (LineHandle line);
+
+	/// Lane to send from next, LANE_COUNT if there is nothing to send
+	Lane nextLane ();
+
+	Lane fairLane        = LANE_INTERACTIVE;
+	bool fairTurnStarted = false;
+
+	PollRates    pollRates;
+	PollActivity lastPollActivity      = POLL_IDLE;
+	uint32_t     pollInterval          = 0;
+	uint32_t     lastStatusRequestTime = 0;
+
+	struct StatusQueryState {
+		etl::atomic< uint32_t > issuedAt{0}; ///< 0 while none is unanswered
+		etl::atomic< uint32_t > sent{0};
+		etl::atomic< uint32_t > skipped{0};
+		etl::atomic< uint32_t > expired{0};
+		uint32_t                rttMs = 0;
+	};
+
+	StatusQueryState statusQueries[ QUERY_COUNT ];
+
+	/// Requests a status update when due at the current activity
+	void pollStatus ();
+
+	uint32_t nextEventTimeout ();
+
 	static GCodeDevice* inst;
 
 	etl::vector< ReceivedLineHandler, 3 > receivedLineHandlers;
@@ -286,9 +639,10 @@ class MarlinDevice : public GCodeDevice {
 
 public:
 	MarlinDevice (Stream* s)
-	    : GCodeDevice (s, 100, 200)
+	    : GCodeDevice (s)
 	{
 		typeStr     = "marlin";
+		lineArena   = &lineSlots;
 		sentCounter = &sentQueue;
 		canTimeout  = true;
 	}
@@ -297,6 +651,7 @@ public:
 	{
 		typeStr = "marlin";
 		;
+		lineArena   = &lineSlots;
 		sentCounter = &sentQueue;
 	}
 
@@ -309,12 +664,13 @@ public:
 		constexpr const char AXIS[] = {'X', 'Y', 'Z', 'E'};
 		char                 msg[ 81 ];
 		snprintf (msg, 81, "G0 F%d %c%04f", feed, AXIS[ axis ], dist);
-		if (xMessageBufferSpacesAvailable (regular_buf) >
-		    strlen (msg) + 3 + 3 + 6)
+		if (getLaneFreeLines (LANE_JOG) < 3 ||
+		    lineArena->FreeSlots () <
+		        size_t{3} + LANE_BUDGETS[ LANE_JOG ].slotReserve)
 			return false;
-		schedulePriorityCommand ("G91");
-		schedulePriorityCommand (msg);
-		schedulePriorityCommand ("G90");
+		submitCommand ("G91", 3, LANE_JOG);
+		submitCommand (msg, strlen (msg), LANE_JOG);
+		submitCommand ("G90", 3, LANE_JOG);
 		return true;
 	}
 
@@ -323,15 +679,12 @@ public:
 		GCodeDevice::begin ();
 		if (!schedulePriorityCommand ("M115"))
 			GD_DEBUGS ("could not schedule M115");
-		if (!schedulePriorityCommand ("M114"))
-			GD_DEBUGS ("could not schedule M114");
-		if (!schedulePriorityCommand ("M105"))
-			GD_DEBUGS ("could not schedule M105");
+		requestStatusUpdate ();
 	}
 
 	virtual void reset ()
 	{
-		cleanupQueue ();
+		requestCleanup ();
 		panic = false;
 		schedulePriorityCommand ("M112");
 		// schedulePriorityCommand("M999");
@@ -339,10 +692,47 @@ public:
 
 	// virtual void receiveResponses() ;
 
+	// Values the printer reports by itself are not polled
 	void requestStatusUpdate () override
 	{
-		schedulePriorityCommand ("M114"); // temp
-		schedulePriorityCommand ("M105"); // pos
+		checkAutoreports ();
+		sampleTemperatureHistory ();
+		if (!autoreportPosEnabled && !isPositionTracked () &&
+		    beginStatusQuery (QUERY_POSITION) &&
+		    !schedulePriorityCommand ("M114"))
+			cancelStatusQuery (QUERY_POSITION);
+		if (!autoreportTempEnabled && beginStatusQuery (QUERY_TEMPERATURE) &&
+		    !schedulePriorityCommand ("M105"))
+			cancelStatusQuery (QUERY_TEMPERATURE);
+	}
+
+	/// Temperatures come from M155 autoreports instead of M105 polls
+	bool isTemperatureAutoreported () const
+	{
+		return autoreportTempEnabled;
+	}
+
+	/// Position comes from M154 autoreports instead of M114 polls
+	bool isPositionAutoreported () const
+	{
+		return autoreportPosEnabled;
+	}
+
+	/**
+	 * Position comes from the motion lines the printer acknowledged, M114
+	 * only checks it now and then. Homing, probing and the like leave it
+	 * unknown until the next M114 reply.
+	 */
+	bool isPositionTracked () const
+	{
+		return motion.known == kMarlinAllAxes &&
+		    millis () - lastPosReportTime < POSITION_RESYNC_TIME;
+	}
+
+	/// M73 P sets the progress shown on the printer's display
+	bool hasBuildPercentCap () const
+	{
+		return fwBuildPercentCap;
 	}
 
 	struct Temperature {
@@ -363,8 +753,81 @@ public:
 		return fwExtruders;
 	}
 
+	/// Readings of an extruder heater, one sample a second
+	const TemperatureHistory& getExtruderHistory (uint8_t e) const
+	{
+		return toolHistory[ e ];
+	}
+	const TemperatureHistory& getBedHistory () const
+	{
+		return bedHistory;
+	}
+
+	static const size_t FLOW_HISTORY_LEN = 60;
+
+	struct FlowWindowStats {
+		uint8_t  window;            ///< Current sent queue line window
+		uint8_t  minWindow;         ///< Since ADVANCED_OK was detected
+		uint8_t  maxWindow;         ///< Since ADVANCED_OK was detected
+		uint8_t  commandBufferSize; ///< Estimate, 0 without ADVANCED_OK
+		uint8_t  plannerFree;       ///< P field of the last ok
+		uint8_t  bufferFree;        ///< B field of the last ok
+		uint32_t windowSum;         ///< Window summed over ok responses
+		uint32_t windowSamples;
+	};
+
+	const FlowWindowStats& getFlowWindowStats () const
+	{
+		return flowStats;
+	}
+
+	/// Window size sampled once a second, oldest first
+	const etl::circular_buffer< uint8_t, FLOW_HISTORY_LEN >&
+	    getFlowWindowHistory () const
+	{
+		return flowHistory;
+	}
+
+	/**
+	 * Sends lines as "N<number> <command>*<checksum>", so that the printer
+	 * detects corrupted lines and asks for them again instead of running
+	 * them. Has to be set before begin().
+	 */
+	void setLineChecksums (bool enable)
+	{
+		lineChecksums = enable;
+	}
+
+	bool getLineChecksums () const
+	{
+		return lineChecksums;
+	}
+
+	struct ResendStats {
+		uint32_t lineErrors;  ///< Checksum and line number errors reported
+		uint32_t requests;    ///< Resend requests received
+		uint32_t ignored;     ///< Repeated requests for the same line
+		uint32_t resentLines; ///< Lines sent more than once
+	};
+
+	const ResendStats& getResendStats () const
+	{
+		return resendStats;
+	}
+
 protected:
-	void trySendCommand () override;
+	bool trySendCommand (LineHandle& line, Lane lane) override;
+
+	bool trySendRetransmits () override;
+
+	void cleanupRegularLines () override
+	{
+		GCodeDevice::cleanupRegularLines ();
+		resendIndex      = NO_RESEND;
+		ignoredResends   = 0;
+		pendingResendOks = 0;
+		lineNumberResync = true;
+	}
 
 	void tryParseResponse (char* cmd, size_t len) override;
 
@@ -372,54 +835,88 @@ private:
 	static const int MAX_SUPPORTED_EXTRUDERS = 3;
 
 	static const size_t MAX_SENT_BYTES = 128;
-	static const size_t MAX_SENT_LINES = 400;
+	static const size_t MAX_SENT_LINES = 24;
+	static const size_t MIN_SENT_LINES = 2;
 
-	SizedQueue< MAX_SENT_LINES, MAX_SENT_BYTES, MAX_GCODE_LINE > sentQueue;
+	// Sent lines are retained until acknowledged, so the arena also bounds
+	// the sent queue
+	StaticLineArena< LineArena::kMaxSlotCount, MAX_GCODE_LINE > lineSlots;
 
-	int  fwExtruders = 1;
-	bool fwAutoreportTempCap, fwProgressCap, fwBuildPercentCap;
-	bool autoreportTempEnabled;
+	SizedQueue< MAX_SENT_LINES, MAX_SENT_BYTES > sentQueue;
 
-	Temperature toolTemperatures[ MAX_SUPPORTED_EXTRUDERS ];
-	Temperature bedTemperature;
+	int  fwExtruders = 1;
+	bool fwAutoreportTempCap   = false;
+	bool fwProgressCap         = false;
+	bool fwBuildPercentCap     = false;
+	bool fwAutoreportPosCap    = false;
+	bool autoreportTempEnabled = false;
+	bool autoreportPosEnabled  = false;
+
+	uint8_t  autoreportSeconds  = 1; ///< S of the M155 and M154 sent
+	uint32_t lastTempReportTime = 0;
+	uint32_t lastPosReportTime  = 0;
+
+	Temperature toolTemperatures[ MAX_SUPPORTED_EXTRUDERS ]{};
+	Temperature bedTemperature{};
+
+	TemperatureHistory toolHistory[ MAX_SUPPORTED_EXTRUDERS ];
+	TemperatureHistory bedHistory;
+	uint32_t           nextHistorySampleTime = 0;
 	String      lastResponse;
+
+	FlowWindowStats                                   flowStats{};
+	etl::circular_buffer< uint8_t, FLOW_HISTORY_LEN > flowHistory;
+	uint32_t                                          nextFlowSampleTime = 0;
 	float       ePos; ///< extruder pos
 
-	bool parseTemperatures (const String& response);
+	MarlinMotionState motion; ///< From the lines acknowledged and M114
 
-	// Parse temperatures from printer responses like
-	// ok T:32.8 /0.0 B:31.8 /0.0 T0:32.8 /0.0 @:0 B@:0
-	bool parseTemp (
-	    const String& response,
-	    const String  whichTemp,
-	    Temperature*  temperature);
+	static const size_t NO_RESEND = SIZE_MAX;
 
-	// Parse position responses from printer like
-	// X:-33.00 Y:-10.00 Z:5.00 E:37.95 Count X:-3300 Y:-1000 Z:2000
-	bool parsePosition (const char* str);
+	bool        lineChecksums    = false;
+	bool        lineNumberResync = true; ///< M110 goes before the next line
+	uint32_t    nextLineNumber   = 0;
+	size_t      resendIndex      = NO_RESEND; ///< Next sent line to repeat
+	uint32_t    resendLineNumber = 0;
+	size_t      ignoredResends   = 0; ///< Stale requests still expected
+	size_t      pendingResendOks = 0; ///< Each request ends with its own ok
+	ResendStats resendStats{};
+
+	size_t composeNumberedLine (
+	    LineHandle line, uint32_t number, char* out, size_t size) const;
+
+	bool trySendNumberedLine (LineHandle line);
 
-	bool parseM115 (const String& str);
-	bool parseG0G1 (const char* str);
+	void requestResend (uint32_t number);
 
-	static float extractFloat (const String& str, const String key);
-	static float extractFloat (const char* str, const char* key);
+	// Asks for the autoreports the M115 reply offered, at the idle poll rate
+	void negotiateAutoreports ();
 
-	static bool isFloat (const String value);
+	// Falls back to polling when autoreports stopped, e.g. after a printer
+	// reset, and asks for them again
+	void checkAutoreports ();
 
-	// Parse temperatures from prusa firmare (sent when heating)
-	// ok T:32.8 E:0 B:31.8
-	static bool extractPrusaHeatingTemp (
-	    const String& response, const String whichTemp, float& temperature);
+	// Adds the last readings to the histories once a sample period, or
+	// missing samples if the printer stopped reporting
+	void sampleTemperatureHistory ();
+
+	// Parse temperatures from printer responses like
+	// ok T:32.8 /0.0 B:31.8 /0.0 T0:32.8 /0.0 @:0 B@:0
+	bool parseTemperatures (const MarlinResponse& response);
+
+	// Parse position responses from printer like
+	// X:-33.00 Y:-10.00 Z:5.00 E:37.95 Count X:-3300 Y:-1000 Z:2000
+	bool parsePosition (const MarlinResponse& response);
 
-	static int extractPrusaHeatingExtruder (const String& response);
+	// Each line of the M115 reply updates the fields it has
+	bool parseM115 (etl::string_view reply);
 
-	static String
-	    extractM115String (const String& response, const String field);
+	// Moves the position by a line the printer acknowledged
+	void trackMotion (const char* cmd);
 
-	static bool extractM115Bool (
-	    const String& response,
-	    const String  field,
-	    const bool    onErrorValue = false);
+	// Adapts sent queue window to ADVANCED_OK reports like
+	// ok P15 B3 or ok N123 P15 B3
+	void updateFlowWindow (const char* resp);
 };
 
 String readStringUntil (Stream& PrinterSerial, char terminator, size_t timeout);
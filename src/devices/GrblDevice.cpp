@@ -3,18 +3,515 @@
 
 bool GrblDevice::jog (uint8_t axis, float dist, int feed)
 {
-	constexpr static char AXIS[] = {'X', 'Y', 'Z'};
-	char                  msg[ 81 ];
+	if ((axis >= kJogAxisCount) || panic)
+	{
+		return false;
+	}
 
-	snprintf (msg, 81, "$J=G91 F%d %c%.3f", feed, AXIS[ axis ], dist);
+	pending_jog_[ axis ].fetch_add (lroundf (dist * kJogDeltaScale));
+	pending_jog_feed_.store (feed);
+	last_jog_step_ms_.store (feed > 0 ? fabsf (dist) / feed * 60000 : 0);
+	last_jog_request_time_.store (millis ());
 
-	return scheduleCommand (msg, strlen (msg));
+	notifyEvent (EVENT_COMMAND);
+
+	return true;
 }
 
 
 bool GrblDevice::canJog ()
 {
-	return status == "Idle" || status == "Jog";
+	return GrblState::kIdle == status_.state ||
+	    GrblState::kJog == status_.state;
+}
+
+
+void GrblDevice::UpdateJog ()
+{
+	auto const now = millis ();
+
+	if (panic)
+	{
+		for (auto&& delta : pending_jog_)
+		{
+			delta.store (0);
+		}
+
+		wheel_turning_ = false;
+
+		return;
+	}
+
+	if (auto const request_time = last_jog_request_time_.load ();
+	    request_time != seen_jog_request_time_)
+	{
+		seen_jog_request_time_ = request_time;
+		wheel_turning_         = true;
+	}
+
+	if (wheel_turning_ && (now - seen_jog_request_time_ >= kWheelStopMs))
+	{
+		wheel_turning_ = false;
+
+		auto const remaining_ms = PendingJogMs () +
+		    (jog_motion_end_ > now ? jog_motion_end_ - now : 0);
+
+		// The motion of a single step is let through, only a backlog left by
+		// a fast spin is cancelled
+		if ((remaining_ms > last_jog_step_ms_.load ()) &&
+		    (remaining_ms > kWheelStopMs))
+		{
+			CancelJog ();
+		}
+	}
+
+	if (HasPendingJog () && (jog_motion_end_ <= now + kJogLeadMs) &&
+	    (0 == getLaneStats (LANE_JOG).lines))
+	{
+		SendPendingJog (now);
+	}
+}
+
+
+bool GrblDevice::HasPendingJog () const noexcept
+{
+	for (auto&& delta : pending_jog_)
+	{
+		if (0 != delta.load ())
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+GrblDevice::JogMotion GrblDevice::PlanJogMotion (
+    const float (&i_distances)[ kJogAxisCount ], float i_feed) const noexcept
+{
+	auto length = 0.0f;
+
+	for (auto const distance : i_distances)
+	{
+		length += distance * distance;
+	}
+
+	length = sqrtf (length);
+
+	if ((length <= 0.0f) || (i_feed <= 0.0f))
+	{
+		return JogMotion{i_feed, 0};
+	}
+
+	auto feed         = i_feed;
+	auto acceleration = 0.0f; ///< Along the jog, units/s^2, 0 if unknown
+
+	// Each axis moves its share of the length, its limits scale up by that
+	for (size_t axis = 0; axis < kJogAxisCount; ++axis)
+	{
+		if (0.0f == i_distances[ axis ])
+		{
+			continue;
+		}
+
+		auto const share = fabsf (i_distances[ axis ]) / length;
+
+		if (auto const max_rate = settings_.MaxRate (axis); max_rate > 0.0f)
+		{
+			feed = min (feed, max_rate / share);
+		}
+
+		if (auto const axis_acceleration = settings_.Acceleration (axis);
+		    axis_acceleration > 0.0f)
+		{
+			auto const limit = axis_acceleration / share;
+
+			acceleration =
+			    (0.0f == acceleration) ? limit : min (acceleration, limit);
+		}
+	}
+
+	auto speed = feed / 60; ///< Units/s
+
+	if (0.0f == acceleration)
+	{
+		return JogMotion{feed, static_cast< uint32_t > (length / speed * 1000)};
+	}
+
+	// Short jogs end braking before they reach the feed
+	speed = min (speed, sqrtf (acceleration * length));
+
+	auto const duration_s = length / speed + speed / acceleration;
+
+	return JogMotion{feed, static_cast< uint32_t > (duration_s * 1000)};
+}
+
+
+uint32_t GrblDevice::PendingJogMs () const noexcept
+{
+	float distances[ kJogAxisCount ];
+
+	for (size_t axis = 0; axis < kJogAxisCount; ++axis)
+	{
+		distances[ axis ] = pending_jog_[ axis ].load () / kJogDeltaScale;
+	}
+
+	return PlanJogMotion (distances, pending_jog_feed_.load ()).duration_ms;
+}
+
+
+bool GrblDevice::ClampJogToTravel (
+    float (&io_distances)[ kJogAxisCount ], uint32_t i_now) const noexcept
+{
+	// Jogs still running start where the previous one ends
+	auto const& start =
+	    (jog_motion_end_ > i_now) ? jog_target_ : status_.machine_position;
+
+	auto clamped = false;
+
+	for (size_t axis = 0; axis < kJogAxisCount; ++axis)
+	{
+		auto&      distance = io_distances[ axis ];
+		auto const position = start[ static_cast< char > ('X' + axis) ];
+
+		float min_position;
+		float max_position;
+
+		if ((0.0f == distance) ||
+		    !settings_.TravelRange (axis, min_position, max_position))
+		{
+			continue;
+		}
+
+		auto const limit = distance > 0.0f
+		    ? max (0.0f, max_position - position)
+		    : min (0.0f, min_position - position);
+
+		if (fabsf (limit) < fabsf (distance))
+		{
+			distance = limit;
+			clamped  = true;
+		}
+	}
+
+	return clamped;
+}
+
+
+void GrblDevice::SendPendingJog (uint32_t i_now)
+{
+	static char constexpr kAxisLetters[ kJogAxisCount ] = {'X', 'Y', 'Z'};
+
+	int32_t deltas[ kJogAxisCount ];
+	float   distances[ kJogAxisCount ];
+
+	for (size_t axis = 0; axis < kJogAxisCount; ++axis)
+	{
+		deltas[ axis ]    = pending_jog_[ axis ].load ();
+		distances[ axis ] = deltas[ axis ] / kJogDeltaScale;
+	}
+
+	auto const clamped = ClampJogToTravel (distances, i_now);
+	auto const motion  = PlanJogMotion (distances, pending_jog_feed_.load ());
+
+	char msg[ 81 ];
+	auto len = snprintf (msg, sizeof (msg), "$J=G91 F%d", int (motion.feed));
+	auto any = false;
+
+	for (size_t axis = 0; axis < kJogAxisCount; ++axis)
+	{
+		// Below the resolution of the pending distances
+		if (fabsf (distances[ axis ]) < 0.5f / kJogDeltaScale)
+		{
+			distances[ axis ] = 0.0f;
+
+			continue;
+		}
+
+		len += snprintf (
+		    msg + len,
+		    sizeof (msg) - len,
+		    " %c%.3f",
+		    kAxisLetters[ axis ],
+		    distances[ axis ]);
+
+		any = true;
+	}
+
+	// Grbl would answer an error, taking the machine out of jog mode
+	if (any && (SubmitResult::OK != submitCommand (msg, len, LANE_JOG)))
+	{
+		return; // stays pending
+	}
+
+	// Steps added by the UI in the meantime stay pending
+	for (size_t axis = 0; axis < kJogAxisCount; ++axis)
+	{
+		pending_jog_[ axis ].fetch_sub (deltas[ axis ]);
+	}
+
+	if (clamped)
+	{
+		jog_clamps_.fetch_add (1);
+
+		GD_DEBUGF ("Jog clamped to travel, %u\n", jog_clamps_.load ());
+	}
+
+	if (!any)
+	{
+		return;
+	}
+
+	auto const& start =
+	    (jog_motion_end_ > i_now) ? jog_target_ : status_.machine_position;
+
+	jog_target_ = Vector3f{
+	    start.x + distances[ 0 ],
+	    start.y + distances[ 1 ],
+	    start.z + distances[ 2 ]};
+
+	jog_motion_end_ = max (jog_motion_end_, i_now) + motion.duration_ms;
+}
+
+
+void GrblDevice::CancelJog ()
+{
+	char const jog_cancel = 0x85;
+
+	schedulePriorityCommand (&jog_cancel, 1);
+
+	dropLane (LANE_JOG);
+
+	for (auto&& delta : pending_jog_)
+	{
+		delta.store (0);
+	}
+
+	jog_motion_end_ = 0;
+
+	jog_cancels_.fetch_add (1);
+
+	GD_DEBUGF ("Jog cancelled, %u\n", jog_cancels_.load ());
+}
+
+
+void GrblDevice::RefreshCaches ()
+{
+	if (settings_stale_ && schedulePriorityCommand ("$$"))
+	{
+		settings_stale_ = false;
+	}
+
+	if (modal_stale_ && schedulePriorityCommand ("$G"))
+	{
+		modal_stale_ = false;
+	}
+}
+
+
+void GrblDevice::SetOverride (GrblOverride i_override, int i_percent)
+{
+	override_targets_[ static_cast< size_t > (i_override) ].store (
+	    GrblOverrideClamp (i_override, i_percent));
+
+	notifyEvent (EVENT_COMMAND);
+}
+
+
+void GrblDevice::AdjustOverride (GrblOverride i_override, int i_delta)
+{
+	auto const target = OverrideTarget (i_override);
+
+	SetOverride (
+	    i_override,
+	    (0 != target ? target : OverrideValue (i_override)) + i_delta);
+}
+
+
+uint8_t GrblDevice::OverrideValue (GrblOverride i_override) const noexcept
+{
+	switch (i_override)
+	{
+	case GrblOverride::kFeed:
+		return status_.feed_override;
+
+	case GrblOverride::kRapid:
+		return status_.rapid_override;
+
+	case GrblOverride::kSpindle:
+		return status_.spindle_override;
+	}
+
+	return kGrblOverrideDefault;
+}
+
+
+bool GrblDevice::HasPendingOverride () const noexcept
+{
+	for (auto&& target : override_targets_)
+	{
+		if (0 != target.load ())
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+void GrblDevice::UpdateOverrides ()
+{
+	auto const now = millis ();
+
+	// The last Ov: report was asked for after the sent bytes were applied
+	auto const report_is_fresh =
+	    static_cast< int32_t > (override_report_time_ - override_send_time_) >=
+	    static_cast< int32_t > (kOverrideSettleMs);
+
+	override_stepping_ = false;
+
+	for (size_t i = 0; i < kGrblOverrideCount; ++i)
+	{
+		auto const kind     = static_cast< GrblOverride > (i);
+		auto       target   = override_targets_[ i ].load ();
+		auto&      expected = override_expected_[ i ];
+
+		if (report_is_fresh)
+		{
+			expected = OverrideValue (kind);
+		}
+
+		if (0 == target)
+		{
+			continue;
+		}
+
+		if (report_is_fresh && (expected == target))
+		{
+			// Confirmed, unless a new target came in meanwhile
+			override_targets_[ i ].compare_exchange_strong (target, 0);
+			override_retries_[ i ] = 0;
+			override_sent_[ i ]    = false;
+
+			continue;
+		}
+
+		if (report_is_fresh && override_sent_[ i ])
+		{
+			override_sent_[ i ] = false;
+
+			++override_mismatches_;
+
+			// Another client or a reset interfered, or Grbl limits differ
+			if (++override_retries_[ i ] > kOverrideMaxRetries)
+			{
+				GD_DEBUGF ("Giving up %s override\n", GrblOverrideName (kind));
+
+				override_targets_[ i ].compare_exchange_strong (target, 0);
+				override_retries_[ i ] = 0;
+
+				++override_failures_;
+
+				continue;
+			}
+		}
+
+		if (expected == target)
+		{
+			continue; // Waiting for the report
+		}
+
+		override_stepping_ = true;
+
+		if (now - override_send_time_ < kOverrideStepMs)
+		{
+			continue;
+		}
+
+		auto const code = GrblOverrideNextByte (kind, expected, target);
+
+		if (0 == code || !schedulePriorityCommand (&code, 1))
+		{
+			continue;
+		}
+
+		expected            = GrblOverrideApply (kind, expected, code);
+		override_sent_[ i ] = true;
+		override_send_time_ = now;
+
+		++override_bytes_sent_;
+	}
+}
+
+
+uint32_t GrblDevice::nextActionDelay ()
+{
+	auto const now   = millis ();
+	auto       delay = uint32_t{DEVICE_EVENT_WAIT_MAX};
+
+	if (HasPendingJog ())
+	{
+		auto const send_time = jog_motion_end_ - kJogLeadMs;
+
+		delay = min (
+		    delay,
+		    (jog_motion_end_ > now + kJogLeadMs) ? send_time - now : 0);
+	}
+
+	if (wheel_turning_)
+	{
+		auto const stop_time = seen_jog_request_time_ + kWheelStopMs;
+
+		delay = min (delay, (stop_time > now) ? stop_time - now : 0);
+	}
+
+	if (settings_stale_ || modal_stale_)
+	{
+		delay = 0;
+	}
+
+	if (override_stepping_)
+	{
+		auto const step_time = override_send_time_ + kOverrideStepMs;
+
+		delay = min (delay, (step_time > now) ? step_time - now : 0);
+	}
+
+	return delay;
+}
+
+
+GCodeDevice::PollActivity GrblDevice::pollActivity ()
+{
+	switch (status_.state)
+	{
+	case GrblState::kRun:
+	case GrblState::kJog:
+	case GrblState::kHome:
+		return POLL_ACTIVE;
+
+	case GrblState::kHold:
+		// Hold:1 is still decelerating, Hold:0 stands still
+		return (0 == status_.substate) ? POLL_IDLE : POLL_ACTIVE;
+
+	case GrblState::kAlarm:
+	case GrblState::kDoor:
+	case GrblState::kSleep:
+		return POLL_ALARM;
+
+	default:
+		break;
+	}
+
+	// The machine is about to move, or overrides wait for confirmation
+	if (wheel_turning_ || HasPendingJog () || HasPendingOverride ())
+	{
+		return POLL_ACTIVE;
+	}
+
+	return GCodeDevice::pollActivity ();
 }
 
 
@@ -60,35 +557,69 @@ bool GrblDevice::isCmdRealtime (char* data, size_t len)
 }
 
 
-void GrblDevice::trySendCommand ()
+bool GrblDevice::trySendCommand (LineHandle& line, Lane lane)
 {
-	if (isCmdRealtime (curUnsentPriorityCmd, curUnsentPriorityCmdLen))
+	char* const  cmd = lineArena->Data (line);
+	size_t const len = lineArena->Length (line);
+
+	// Realtime commands bypass the RX buffer accounting
+	if (LANE_REALTIME == lane && isCmdRealtime (cmd, len))
 	{
-		printerSerial->write (curUnsentPriorityCmd, curUnsentPriorityCmdLen);
+		if (!appendTxBatch (cmd, len, false))
+		{
+			return false;
+		}
 
 		GD_DEBUGF (
 		    "<  (f%3d,%3d) '%c' RT\n",
 		    sentCounter->getFreeLines (),
 		    sentCounter->getFreeBytes (),
-		    curUnsentPriorityCmd[ 0 ]);
+		    cmd[ 0 ]);
+	}
+	else
+	{
+		auto const command = etl::string_view{cmd, len};
 
-		curUnsentPriorityCmdLen = 0;
+		auto modal_state   = modal_state_;
+		auto modal_changes = uint8_t{0};
 
-		return;
-	}
+		// Pendant lines setting modes that are set already are dropped, lines
+		// from other clients wait for their ok
+		if (!ApplyGrblModalLine (command, modal_state, &modal_changes) &&
+		    lineArena->Origin (line).modes_only)
+		{
+			modal_lines_skipped_.fetch_add (1);
 
-	char* cmd = (curUnsentPriorityCmdLen != 0) ? &curUnsentPriorityCmd[ 0 ]
-	                                           : &curUnsentCmd[ 0 ];
-	auto& len = (curUnsentPriorityCmdLen != 0) ? curUnsentPriorityCmdLen
-	                                           : curUnsentCmdLen;
+			GD_DEBUGF ("<  '%s' skipped, modes are set\n", cmd);
 
-	if (sentCounter->canPush (len))
-	{
-		sentCounter->push (cmd, len);
+			lineArena->Release (line);
+
+			line = kNoLine;
+
+			return true;
+		}
+
+		if (!sentCounter->canPush (len) || !appendTxBatch (cmd, len, true))
+		{
+			return false;
+		}
+
+		sentQueue.push (
+		    len,
+		    LineRecord{lineArena->Origin (line), lineHash (cmd, len), lane});
 
-		printerSerial->write (cmd, len);
+		modal_state_ = modal_state;
+		modal_query_changes_ |= modal_changes;
 
-		printerSerial->print ('\n');
+		if ("$G" == command)
+		{
+			modal_query_changes_ = 0;
+		}
+
+		if (IsGrblSettingsWrite (command))
+		{
+			settings_stale_ = true;
+		}
 
 		GD_DEBUGF (
 		    "<  (f%3d,%3d) '%s' (%d)\n",
@@ -96,9 +627,13 @@ void GrblDevice::trySendCommand ()
 		    sentCounter->getFreeBytes (),
 		    cmd,
 		    len);
-
-		len = 0;
 	}
+
+	lineArena->Release (line);
+
+	line = kNoLine;
+
+	return true;
 }
 
 
@@ -108,17 +643,25 @@ void GrblDevice::tryParseResponse (char* i_resp, size_t i_length)
 
 	if (response.starts_with ("ok"))
 	{
-		sentQueue.pop ();
+		acknowledgeLine ();
 
 		connected = true;
 		panic     = false;
 	}
 	else if (response.starts_with ("error") || response.starts_with ("ALARM:"))
 	{
-		sentQueue.pop ();
+		RecordError (response);
+
+		acknowledgeLine ();
 
 		panic = true;
 
+		// The failed line did not set its modes, and which ones it assumed
+		// may be lost if $G went out since. Nothing counts as set already
+		// until the $G reply tells.
+		modal_state_.known = 0;
+		modal_stale_       = true;
+
 		GD_DEBUGF ("ERR '%s'\n", i_resp);
 
 		notify_observers (DeviceStatusEvent{1});
@@ -129,6 +672,38 @@ void GrblDevice::tryParseResponse (char* i_resp, size_t i_length)
 	{
 		parseGrblStatus (response);
 	}
+	else if (response.starts_with ("$"))
+	{
+		settings_.ParseLine (response);
+	}
+	else if (response.starts_with ("[PRB:"))
+	{
+		if (GrblProbeResult result; ParseGrblProbeResult (response, result))
+		{
+			auto const count = probe_count_.load ();
+
+			probe_started_.store (count + 1);
+
+			probe_result_ = result;
+
+			probe_count_.store (count + 1);
+		}
+	}
+	else if (response.starts_with ("[GC:"))
+	{
+		ParseGrblModalReport (response, modal_state_, modal_query_changes_);
+	}
+	else if (response.starts_with ("Grbl ") ||
+	         response.starts_with ("GrblHAL "))
+	{
+		// Reset, the parser starts over with its defaults
+		modal_state_ = GrblModalState{};
+		modal_stale_ = true;
+	}
+	else if (response.starts_with ("[OPT:"))
+	{
+		parseBuildOptions (response);
+	}
 	else if (response.starts_with ("[MSG:"))
 	{
 		GD_DEBUGF ("Msg '%s'\n", i_resp);
@@ -146,147 +721,142 @@ void GrblDevice::tryParseResponse (char* i_resp, size_t i_length)
 }
 
 
-void GrblDevice::parseGrblStatus (etl::string_view i_status_string)
+uint32_t GrblDevice::ProbeResult (GrblProbeResult& o_result) const noexcept
 {
-	static auto constexpr kSeparator = '|';
+	for (;;)
+	{
+		auto const count = probe_count_.load ();
+
+		o_result = probe_result_;
+
+		// Otherwise a reply was written meanwhile
+		if (probe_started_.load () == count)
+		{
+			return count;
+		}
+	}
+}
 
 
-	struct Coordinates {
-		float x{};
-		float y{};
-		float z{};
-	};
+void GrblDevice::RecordError (etl::string_view i_response)
+{
+	//error:20
+	//ALARM:2
 
+	auto record = GrblErrorRecord{};
 
-	static auto constexpr ConsumeCoordinatesTriplet = [] (auto&& i_string) {
-		Coordinates coordinates;
+	record.time  = millis ();
+	record.alarm = i_response.starts_with ("ALARM:");
 
-		coordinates.x = atof (i_string.data ());
+	// Grbl 0.9 sends text instead of codes, those stay unknown
+	if (auto const colon = i_response.find (':');
+	    etl::string_view::npos != colon)
+	{
+		auto code = 0;
 
-		i_string.remove_prefix (i_string.find_first_of (',') + 1);
+		for (auto i = colon + 1; (i < i_response.size ()) && (code < 256) &&
+		     (i_response[ i ] >= '0') && (i_response[ i ] <= '9');
+		     ++i)
+		{
+			code = code * 10 + (i_response[ i ] - '0');
+		}
 
-		coordinates.y = atof (i_string.data ());
+		record.code = code < 256 ? static_cast< uint8_t > (code) : 0;
+	}
 
-		i_string.remove_prefix (i_string.find_first_of (',') + 1);
+	if (auto const line = sentQueue.front (); nullptr != line)
+	{
+		record.has_line    = true;
+		record.file_offset = line->origin.file_offset;
+		record.line_number = line->origin.line_number;
+		record.line_hash   = line->hash;
+		record.lane        = line->lane;
+	}
 
-		coordinates.z = atof (i_string.data ());
+	error_log_.Add (record);
 
-		return coordinates;
-	};
+	GD_DEBUGF (
+	    "%s %d '%s', line %u\n",
+	    record.alarm ? "Alarm" : "Error",
+	    record.code,
+	    record.Message (),
+	    record.line_number);
+}
 
 
-	//<Idle|MPos:9.800,0.000,0.000|FS:0,0|WCO:0.000,0.000,0.000>
-	//<Idle|MPos:9.800,0.000,0.000|FS:0,0|Ov:100,100,100>
+void GrblDevice::parseBuildOptions (etl::string_view i_options_string)
+{
+	//[OPT:V,15,128]
+	//[OPT:VNMSL,35,1024,3,0] (grblHAL appends more fields)
 
-	// Remove '<' at the beginning of the status string
-	i_status_string.remove_prefix (1);
+	i_options_string.remove_prefix (sizeof ("[OPT:") - 1);
 
-	if (auto const status_separator_pos =
-	        i_status_string.find_first_of (kSeparator);
-	    etl::string_view::npos != status_separator_pos)
+	// Skip option codes
+	if (auto const codes_end = i_options_string.find_first_of (',');
+	    etl::string_view::npos != codes_end)
 	{
-		status = String{i_status_string.data (), status_separator_pos};
-
-		i_status_string.remove_prefix (status_separator_pos + 1);
+		i_options_string.remove_prefix (codes_end + 1);
 	}
 	else
 	{
 		return;
 	}
 
-	// MPos:0.000,0.000,0.000
-	if (auto const mpos_separator_pos =
-	        i_status_string.find_first_of (kSeparator);
-	    etl::string_view::npos != mpos_separator_pos)
-	{
-		auto mpos_view = i_status_string;
-
-		mpos_view.remove_prefix (sizeof ("MPos:") - 1);
-
-		auto const coordinates = ConsumeCoordinatesTriplet (mpos_view);
-
-		x = coordinates.x;
-		y = coordinates.y;
-		z = coordinates.z;
+	auto const blocks = atoi (i_options_string.data ());
 
-		i_status_string.remove_prefix (mpos_separator_pos + 1);
+	if (auto const blocks_end = i_options_string.find_first_of (',');
+	    etl::string_view::npos != blocks_end)
+	{
+		i_options_string.remove_prefix (blocks_end + 1);
 	}
 	else
 	{
 		return;
 	}
 
-	input_pin_state_.clear ();
-
-	enum InfoMask {
-		kSpindleAndFeed = 0b001,
-		kWco            = 0b010,
-		kInputPinState  = 0b100
-	};
-
-	auto parsed_info = int{};
+	auto const rx_bytes = atoi (i_options_string.data ());
 
-	input_pin_state_.clear ();
-
-	for (auto next_separator_pos = i_status_string.find_first_of (kSeparator);
-	     etl::string_view::npos != next_separator_pos;
-	     i_status_string.remove_prefix (next_separator_pos + 1),
-	          next_separator_pos = i_status_string.find_first_of (kSeparator))
+	if ((0 >= blocks) || (0 >= rx_bytes))
 	{
-		auto current_info_view = i_status_string;
-
-		if (!(parsed_info & InfoMask::kSpindleAndFeed) &&
-		    (current_info_view.starts_with ("FS:") ||
-		     current_info_view.starts_with ("F:")))
-		{
-			if ('S' == current_info_view[ 1 ])
-			{
-				current_info_view.remove_prefix (sizeof ("FS:") - 1);
+		return;
+	}
 
-				feed = atof (current_info_view.data ());
+	planner_blocks_ = blocks;
+	rx_buffer_size_ = rx_bytes;
 
-				current_info_view.remove_prefix (
-				    current_info_view.find_first_of (',') + 1);
+	/*
+	  Grbl serial ring buffer holds one byte less than its size. The planner
+	  does not limit streaming since Grbl stops reading from the RX buffer when
+	  the planner is full, so only the storage bounds the line count.
+	*/
+	sentQueue.setCapacity (decltype (sentQueue)::kMaxLines, rx_bytes - 1);
 
-				spindleVal = atoi (current_info_view.data ());
-			}
-			else
-			{
-				current_info_view.remove_prefix (sizeof ("F:") - 1);
+	GD_DEBUGF ("Grbl buffers: %d blocks, %d RX bytes\n", blocks, rx_bytes);
+}
 
-				feed = atoi (current_info_view.data ());
-			}
 
-			parsed_info |= InfoMask::kSpindleAndFeed;
-		}
-		else if (
-		    !(parsed_info & InfoMask::kWco) &&
-		    current_info_view.starts_with ("WCO:"))
-		{
-			current_info_view.remove_prefix (sizeof ("WCO:") - 1);
+void GrblDevice::parseGrblStatus (etl::string_view i_status_string)
+{
+	if (!ParseGrblStatus (i_status_string, status_))
+	{
+		GD_DEBUGF ("Bad status report\n");
 
-			auto const wco = ConsumeCoordinatesTriplet (current_info_view);
+		return;
+	}
 
-			ofsX = wco.x;
-			ofsY = wco.y;
-			ofsZ = wco.z;
+	if (status_.fields & kFieldOverrides)
+	{
+		override_report_time_ = status_query_time_;
+	}
 
-			parsed_info |= InfoMask::kWco;
-		}
-		else if (
-		    !(parsed_info & InfoMask::kInputPinState) &&
-		    current_info_view.starts_with ("Pn:"))
-		{
-			static auto constexpr kPnPrefixSize = sizeof ("Pn:") - 1;
+	statusQueryAnswered (QUERY_POSITION);
 
-			input_pin_state_ = String{
-			    current_info_view.data () + kPnPrefixSize,
-			    static_cast< unsigned int > (
-			        next_separator_pos - kPnPrefixSize + 1)};
+	status_report_time_ = millis () | 1;
 
-			parsed_info |= InfoMask::kInputPinState;
-		}
-	}
+	// Device position is the work position, as shown by the DRO
+	x = status_.work_position.x;
+	y = status_.work_position.y;
+	z = status_.work_position.z;
 
 	notify_observers (DeviceStatusEvent{0});
 }
@@ -2,17 +2,24 @@
 #define SRC_DEVICES_GRBLDEVICE_HPP
 
 
+#include <etl/atomic.h>
 #include <etl/string_view.h>
 
 #include "GCodeDevice.h"
+#include "GrblErrors.hpp"
+#include "GrblModal.hpp"
+#include "GrblOverrides.hpp"
+#include "GrblSettings.hpp"
+#include "GrblStatus.hpp"
 
 
 class GrblDevice : public GCodeDevice {
 public:
 	GrblDevice (Stream* s)
-	    : GCodeDevice (s, 20, 100)
+	    : GCodeDevice (s)
 	{
 		typeStr     = "grbl";
+		lineArena   = &line_slots_;
 		sentCounter = &sentQueue;
 		canTimeout  = false;
 	};
@@ -22,18 +29,39 @@ public:
 	    : GCodeDevice ()
 	{
 		typeStr     = "grbl";
+		lineArena   = &line_slots_;
 		sentCounter = &sentQueue;
 	}
 
 
 	virtual ~GrblDevice () = default;
 
-	const String& InputPinState () const noexcept
+	/// Decoded fields of the last status report
+	const GrblStatus& Status () const noexcept
 	{
-		return input_pin_state_;
+		return status_;
 	}
 
 
+	/// Arrival time of the last status report, 0 before the first one
+	uint32_t StatusReportTime () const noexcept
+	{
+		return status_report_time_.load ();
+	}
+
+
+	/// GrblPin bits of the pins active in the last status report
+	uint16_t InputPins () const noexcept
+	{
+		return status_.pins;
+	}
+
+
+	/**
+	 * Adds the distance to the pending jog of the axis. Pending jogs of all
+	 * axes are merged into a single $J= command, sent by the device task
+	 * shortly before the previous jog is expected to end.
+	 */
 	bool jog (uint8_t axis, float dist, int feed) override;
 
 	bool canJog () override;
@@ -44,8 +72,10 @@ public:
 		GCodeDevice::begin ();
 
 		schedulePriorityCommand ("$I");
+		schedulePriorityCommand ("$$");
+		schedulePriorityCommand ("$G");
 
-		schedulePriorityCommand ("?");
+		requestStatusUpdate ();
 	}
 
 
@@ -53,7 +83,13 @@ public:
 	{
 		panic = false;
 
-		cleanupQueue ();
+		requestCleanup ();
+
+		// Grbl starts over at 100%
+		for (auto& target : override_targets_)
+		{
+			target.store (0);
+		}
 
 		char c = 0x18;
 
@@ -61,46 +97,168 @@ public:
 	}
 
 
+	void loop () override
+	{
+		UpdateJog ();
+
+		UpdateOverrides ();
+
+		RefreshCaches ();
+
+		GCodeDevice::loop ();
+	}
+
+
+	/// Jogs cancelled because the wheel stopped ahead of the machine
+	uint32_t JogCancelCount () const noexcept
+	{
+		return jog_cancels_.load ();
+	}
+
+
+	/// Jogs shortened or dropped to stay within the soft limits
+	uint32_t JogClampCount () const noexcept
+	{
+		return jog_clamps_.load ();
+	}
+
+
+	/**
+	 * $$ settings, fetched at start and again after each command that
+	 * changes them. Only for the device task.
+	 */
+	const GrblSettings& Settings () const noexcept
+	{
+		return settings_;
+	}
+
+
+	/**
+	 * Parser modes after the lines sent so far, from $G replies and the sent
+	 * lines themselves. Asked for again after errors and resets.
+	 */
+	const GrblModalState& ModalState () const noexcept
+	{
+		return modal_state_;
+	}
+
+
+	/**
+	 * Errors and alarms, each with the line that was waiting for its answer.
+	 * For alarms that is the oldest line in flight, most likely the one the
+	 * machine was executing.
+	 */
+	const GrblErrorLog& ErrorLog () const noexcept
+	{
+		return error_log_;
+	}
+
+
+	/**
+	 * Copies the last [PRB:] reply, from any task.
+	 *
+	 * @return number of replies so far, 0 if there was none yet
+	 */
+	uint32_t ProbeResult (GrblProbeResult& o_result) const noexcept;
+
+
+	/// UI lines not sent because they set modes that were set already
+	uint32_t ModalSkipCount () const noexcept
+	{
+		return modal_lines_skipped_.load ();
+	}
+
+
 	virtual void requestStatusUpdate () override
 	{
-		schedulePriorityCommand ("?");
+		if (!beginStatusQuery (QUERY_POSITION))
+		{
+			return;
+		}
+
+		if (schedulePriorityCommand ("?"))
+		{
+			status_query_time_ = millis ();
+		}
+		else
+		{
+			cancelStatusQuery (QUERY_POSITION);
+		}
+	}
+
+
+	struct OverrideStats {
+		uint32_t bytes_sent;
+		uint32_t mismatches; ///< Reports that missed the expected value
+		uint32_t failures;   ///< Targets dropped after too many mismatches
+	};
+
+
+	/**
+	 * Requests an override percentage, from any task. The device task sends
+	 * the realtime bytes that get there and checks the result against the
+	 * Ov: field of the following status reports.
+	 */
+	void SetOverride (GrblOverride i_override, int i_percent);
+
+	/// Relative to the pending target, or to the reported value without one
+	void AdjustOverride (GrblOverride i_override, int i_delta);
+
+
+	/// As last reported by the machine
+	uint8_t OverrideValue (GrblOverride i_override) const noexcept;
+
+
+	/// Requested value not confirmed yet, 0 without one
+	uint8_t OverrideTarget (GrblOverride i_override) const noexcept
+	{
+		return override_targets_[ static_cast< size_t > (i_override) ].load ();
+	}
+
+
+	OverrideStats GetOverrideStats () const noexcept
+	{
+		return {
+		    override_bytes_sent_.load (),
+		    override_mismatches_.load (),
+		    override_failures_.load ()};
 	}
 
 
 	/// WPos = MPos - WCO
 	float getXOfs ()
 	{
-		return ofsX;
+		return status_.work_coordinate_offset.x;
 	}
 
 
 	float getYOfs ()
 	{
-		return ofsY;
+		return status_.work_coordinate_offset.y;
 	}
 
 
 	float getZOfs ()
 	{
-		return ofsZ;
+		return status_.work_coordinate_offset.z;
 	}
 
 
 	uint getSpindleVal ()
 	{
-		return spindleVal;
+		return status_.spindle_speed;
 	}
 
 
 	uint getFeed ()
 	{
-		return feed;
+		return static_cast< uint > (status_.feed);
 	}
 
 
-	const String& getStatus ()
+	const char* getStatus ()
 	{
-		return status;
+		return GrblStateName (status_.state);
 	}
 
 
@@ -110,27 +268,176 @@ public:
 	}
 
 
+	/// As reported in the [OPT:] line of the $I reply
+	size_t PlannerBlocks () const noexcept
+	{
+		return planner_blocks_;
+	}
+
+
+	/// As reported in the [OPT:] line of the $I reply
+	size_t RxBufferSize () const noexcept
+	{
+		return rx_buffer_size_;
+	}
+
+
 protected:
-	void trySendCommand () override;
+	bool trySendCommand (LineHandle& line, Lane lane) override;
 
 	void tryParseResponse (char* cmd, size_t len) override;
 
+	uint32_t nextActionDelay () override;
+
+	PollActivity pollActivity () override;
+
 
 private:
-	SimpleCounter< 15, 128 > sentQueue;
+	/*
+	  Character counting needs only line lengths, so slots are released as soon
+	  as a line is written and the arena holds scheduled lines only.
+	*/
+	StaticLineArena< 16, MAX_GCODE_LINE > line_slots_;
+
+	// Stock Grbl sizes, used until the $I reply tells the actual ones
+	static size_t constexpr kDefaultPlannerBlocks = 15;
+	static size_t constexpr kDefaultRxBufferSize  = 128;
+
+	SimpleCounter<> sentQueue{kDefaultPlannerBlocks, kDefaultRxBufferSize};
+
+	size_t planner_blocks_{kDefaultPlannerBlocks};
+	size_t rx_buffer_size_{kDefaultRxBufferSize};
+
+	static size_t constexpr kJogAxisCount = 3;
+
+	/// Pending jog distances are kept in thousandths of the machine units
+	static float constexpr kJogDeltaScale = 1000.0f;
+
+	/// The next jog is sent this long before the previous one should end
+	static uint32_t constexpr kJogLeadMs = 50;
+
+	/// No jog request for this long means the wheel has stopped
+	static uint32_t constexpr kWheelStopMs = 200;
+
+	// Written by the UI task, taken by the device task
+	etl::atomic< int32_t >  pending_jog_[ kJogAxisCount ] = {};
+	etl::atomic< int32_t >  pending_jog_feed_{0};
+	etl::atomic< uint32_t > last_jog_request_time_{0};
+	etl::atomic< uint32_t > last_jog_step_ms_{0};
+	etl::atomic< uint32_t > jog_cancels_{0};
+	etl::atomic< uint32_t > jog_clamps_{0};
+
+	uint32_t seen_jog_request_time_{0};
+	uint32_t jog_motion_end_{0}; ///< When the sent jogs are expected to end
+	bool     wheel_turning_{false};
+
+	/// Machine position the sent jogs end at, while they run
+	Vector3f jog_target_;
+
+	struct JogMotion {
+		float    feed;
+		uint32_t duration_ms;
+	};
+
+	void UpdateJog ();
+
+	bool HasPendingJog () const noexcept;
+
+	/**
+	 * Feed limited by the axis max rates and duration including the
+	 * acceleration and deceleration, of a jog by the distances.
+	 */
+	JogMotion PlanJogMotion (
+	    const float (&i_distances)[ kJogAxisCount ],
+	    float i_feed) const noexcept;
+
+	/// Expected duration of the jog not sent yet
+	uint32_t PendingJogMs () const noexcept;
+
+	/**
+	 * Shortens the distances so the jog ends within the soft limits. Never
+	 * reverses a distance, even when the machine is out of range.
+	 *
+	 * @return true if some distance was shortened
+	 */
+	bool ClampJogToTravel (
+	    float (&io_distances)[ kJogAxisCount ], uint32_t i_now) const noexcept;
+
+	void SendPendingJog (uint32_t i_now);
+
+	void CancelJog ();
+
+	/*
+	  Grbl keeps override requests as flags until its main loop gets to them,
+	  two equal bytes arriving in between count once. Bytes are spaced out
+	  and the result is checked against the Ov: report.
+	*/
+	static uint32_t constexpr kOverrideStepMs = 20;
+
+	/// Reports asked for this long after the last byte show its effect
+	static uint32_t constexpr kOverrideSettleMs = 10;
+
+	/// Mismatching reports before a target is given up
+	static uint8_t constexpr kOverrideMaxRetries = 3;
+
+	// Written by the UI and web tasks, 0 without a pending target
+	etl::atomic< uint8_t > override_targets_[ kGrblOverrideCount ] = {};
+
+	etl::atomic< uint32_t > override_bytes_sent_{0};
+	etl::atomic< uint32_t > override_mismatches_{0};
+	etl::atomic< uint32_t > override_failures_{0};
+
+	/// Values the sent bytes lead to, the reported ones once confirmed
+	uint8_t override_expected_[ kGrblOverrideCount ] = {
+	    kGrblOverrideDefault, kGrblOverrideDefault, kGrblOverrideDefault};
+	uint8_t override_retries_[ kGrblOverrideCount ] = {};
+	bool    override_sent_[ kGrblOverrideCount ]    = {};
+	bool    override_stepping_{false}; ///< Some bytes are still to be sent
+
+	uint32_t override_send_time_{0};
+	uint32_t override_report_time_{0}; ///< Query time of the last Ov: report
+	uint32_t status_query_time_{0};
+
+	void UpdateOverrides ();
+
+	bool HasPendingOverride () const noexcept;
 
 	String lastResponse;
 
-	String status;
+	GrblStatus status_;
+
+	GrblSettings settings_;
+
+	bool settings_stale_{false}; ///< A sent command changed the settings
+
+	GrblModalState modal_state_;
+
+	/// GrblModalField bits changed by lines sent after the last $G
+	uint8_t modal_query_changes_{0};
 
-	String input_pin_state_;
+	bool modal_stale_{false}; ///< Lines may have failed, or Grbl was reset
 
-	// WPos = MPos - WCO
-	float ofsX, ofsY, ofsZ;
-	uint  feed, spindleVal;
+	etl::atomic< uint32_t > modal_lines_skipped_{0};
+
+	GrblErrorLog error_log_;
+
+	// Written by the device task, the count last
+	GrblProbeResult         probe_result_;
+	etl::atomic< uint32_t > probe_count_{0};
+	etl::atomic< uint32_t > probe_started_{0}; ///< Count once written
+
+	/// Logs an error: or ALARM: response, before its line is acknowledged
+	void RecordError (etl::string_view i_response);
+
+	/// Asks for the $$ settings and the $G modes again when they are stale
+	void RefreshCaches ();
+
+	etl::atomic< uint32_t > status_report_time_{0};
 
 	void parseGrblStatus (etl::string_view i_status_string);
 
+	void parseBuildOptions (etl::string_view i_options_string);
+
 	bool isCmdRealtime (char* data, size_t len);
 };
 
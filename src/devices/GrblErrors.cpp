@@ -0,0 +1,137 @@
+#include "GrblErrors.hpp"
+
+
+namespace {
+	struct CodeMessage {
+		uint8_t     code;
+		const char* message;
+	};
+
+
+	// Grbl 1.1 codes, short enough for a few LCD lines
+	CodeMessage constexpr kErrorMessages[] = {
+	    {1, "Expected command letter"},
+	    {2, "Bad number format"},
+	    {3, "Invalid $ statement"},
+	    {4, "Negative value"},
+	    {5, "Homing not enabled"},
+	    {6, "Step pulse under 3us"},
+	    {7, "EEPROM read failed"},
+	    {8, "$ command needs Idle"},
+	    {9, "Locked by alarm or jog"},
+	    {10, "Soft limits need homing"},
+	    {11, "Line too long"},
+	    {12, "Step rate over 30kHz"},
+	    {13, "Safety door open"},
+	    {14, "Line too long for EEPROM"},
+	    {15, "Jog beyond machine travel"},
+	    {16, "Invalid jog command"},
+	    {17, "Laser mode needs PWM"},
+	    {20, "Unsupported G-code"},
+	    {21, "Modal group conflict"},
+	    {22, "Feed rate not set"},
+	    {23, "Integer value required"},
+	    {24, "Two axis word commands"},
+	    {25, "Repeated word"},
+	    {26, "No axis words"},
+	    {27, "Invalid line number"},
+	    {28, "Missing value word"},
+	    {29, "G59.x not supported"},
+	    {30, "G53 needs G0 or G1"},
+	    {31, "Unused axis words"},
+	    {32, "Arc needs in-plane axis"},
+	    {33, "Invalid motion target"},
+	    {34, "Invalid arc radius"},
+	    {35, "Arc needs in-plane offset"},
+	    {36, "Unused value words"},
+	    {37, "G43.1 axis mismatch"},
+	    {38, "Tool number too high"},
+	};
+
+
+	CodeMessage constexpr kAlarmMessages[] = {
+	    {1, "Hard limit triggered"},
+	    {2, "Soft limit exceeded"},
+	    {3, "Reset while moving"},
+	    {4, "Probe not in start state"},
+	    {5, "Probe made no contact"},
+	    {6, "Homing: reset"},
+	    {7, "Homing: door opened"},
+	    {8, "Homing: pull-off failed"},
+	    {9, "Homing: no limit switch"},
+	    {10, "Homing: second switch"},
+	};
+
+
+	template < size_t KCount >
+	const char* FindMessage (
+	    const CodeMessage (&i_messages)[ KCount ],
+	    uint8_t     i_code,
+	    const char* i_unknown) noexcept
+	{
+		for (auto const& entry : i_messages)
+		{
+			if (i_code == entry.code)
+			{
+				return entry.message;
+			}
+		}
+
+		return i_unknown;
+	}
+} // namespace
+
+
+const char* GrblErrorMessage (uint8_t i_code) noexcept
+{
+	return FindMessage (kErrorMessages, i_code, "Unknown error");
+}
+
+
+const char* GrblAlarmMessage (uint8_t i_code) noexcept
+{
+	return FindMessage (kAlarmMessages, i_code, "Unknown alarm");
+}
+
+
+void GrblErrorLog::Add (const GrblErrorRecord& i_record) noexcept
+{
+	auto const count = count_.load ();
+
+	started_.store (count + 1);
+
+	records_[ count % kCapacity ] = i_record;
+
+	count_.store (count + 1);
+}
+
+
+size_t GrblErrorLog::Snapshot (
+    GrblErrorRecord (&o_records)[ kCapacity ]) const noexcept
+{
+	auto const count_before = count_.load ();
+	auto const first =
+	    count_before > kCapacity ? count_before - kCapacity : uint32_t{0};
+
+	for (auto i = first; i < count_before; ++i)
+	{
+		o_records[ i - first ] = records_[ i % kCapacity ];
+	}
+
+	// Records in slots written meanwhile may be torn
+	auto const started    = started_.load ();
+	auto const valid_from = started > kCapacity ? started - kCapacity : 0;
+	auto const skip = valid_from > first ? valid_from - first : uint32_t{0};
+
+	if (skip >= count_before - first)
+	{
+		return 0;
+	}
+
+	for (auto i = skip; i < count_before - first; ++i)
+	{
+		o_records[ i - skip ] = o_records[ i ];
+	}
+
+	return count_before - first - skip;
+}
@@ -0,0 +1,70 @@
+#ifndef SRC_DEVICES_GRBLERRORS_HPP
+#define SRC_DEVICES_GRBLERRORS_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <etl/atomic.h>
+
+
+/// Short text of an "error:N" code, "Unknown error" for codes not listed
+const char* GrblErrorMessage (uint8_t i_code) noexcept;
+
+
+/// Short text of an "ALARM:N" code, "Unknown alarm" for codes not listed
+const char* GrblAlarmMessage (uint8_t i_code) noexcept;
+
+
+struct GrblErrorRecord {
+	uint32_t time{0};         ///< millis () when it was reported
+	uint32_t file_offset{0};  ///< Of the job file line
+	uint32_t line_number{0};  ///< Job file line, 0 if not from a job
+	uint16_t line_hash{0};    ///< lineHash () of the line as sent
+	uint8_t  code{0};         ///< N of error:N or ALARM:N
+	uint8_t  lane{0};         ///< GCodeDevice::Lane the line was sent from
+	bool     alarm{false};    ///< ALARM:, error: otherwise
+	bool     has_line{false}; ///< A sent line was waiting for its answer
+
+	const char* Message () const noexcept
+	{
+		return alarm ? GrblAlarmMessage (code) : GrblErrorMessage (code);
+	}
+};
+
+
+/**
+ * The last errors and alarms, newest replacing the oldest. Added by the
+ * device task, read by any task without locking: a reader drops records
+ * that may have been overwritten while it copied them.
+ */
+class GrblErrorLog {
+public:
+	static size_t constexpr kCapacity = 16;
+
+	/// Device task only
+	void Add (const GrblErrorRecord& i_record) noexcept;
+
+	/**
+	 * Copies the records still held, oldest first.
+	 *
+	 * @return number of records copied
+	 */
+	size_t Snapshot (GrblErrorRecord (&o_records)[ kCapacity ]) const noexcept;
+
+	/// Records added since start, including those replaced since
+	uint32_t Count () const noexcept
+	{
+		return count_.load ();
+	}
+
+
+private:
+	GrblErrorRecord records_[ kCapacity ];
+
+	etl::atomic< uint32_t > count_{0};
+	etl::atomic< uint32_t > started_{0}; ///< Count once the write under way ends
+};
+
+
+#endif // SRC_DEVICES_GRBLERRORS_HPP
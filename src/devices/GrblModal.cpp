@@ -0,0 +1,333 @@
+#include "GrblModal.hpp"
+
+
+namespace {
+	enum class Scan {
+		kEnd,
+		kWord,
+		kBad,
+	};
+
+
+	/**
+	 * Takes the next word from the front of the line, skipping blanks and
+	 * comments. The value is kept in tenths, G92.1 gives 921; further
+	 * decimals are dropped, they do not matter for modal words.
+	 */
+	Scan NextWord (
+	    etl::string_view& io_line, char& o_letter, int32_t& o_tenths) noexcept
+	{
+		while (!io_line.empty ())
+		{
+			auto const c = io_line[ 0 ];
+
+			if ((' ' == c) || ('\t' == c) || ('\r' == c) || ('\n' == c))
+			{
+				io_line.remove_prefix (1);
+			}
+			else if ('(' == c)
+			{
+				auto const end = io_line.find (')');
+
+				if (etl::string_view::npos == end)
+				{
+					return Scan::kBad;
+				}
+
+				io_line.remove_prefix (end + 1);
+			}
+			else if (';' == c)
+			{
+				return Scan::kEnd;
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		if (io_line.empty ())
+		{
+			return Scan::kEnd;
+		}
+
+		o_letter = io_line[ 0 ];
+
+		if (o_letter >= 'a' && o_letter <= 'z')
+		{
+			o_letter -= 'a' - 'A';
+		}
+
+		if (o_letter < 'A' || o_letter > 'Z')
+		{
+			return Scan::kBad;
+		}
+
+		io_line.remove_prefix (1);
+
+		auto const negative = !io_line.empty () && ('-' == io_line[ 0 ]);
+
+		if (negative || (!io_line.empty () && ('+' == io_line[ 0 ])))
+		{
+			io_line.remove_prefix (1);
+		}
+
+		auto value    = int32_t{0};
+		auto digits   = 0;
+		auto decimals = -1; ///< -1 before the decimal point
+
+		while (!io_line.empty ())
+		{
+			auto const c = io_line[ 0 ];
+
+			if ((c >= '0') && (c <= '9'))
+			{
+				// Large values only need to stay large
+				if ((decimals < 1) && (value < 100000000))
+				{
+					value = value * 10 + (c - '0');
+				}
+
+				decimals += (decimals >= 0) ? 1 : 0;
+				++digits;
+			}
+			else if (('.' == c) && (decimals < 0))
+			{
+				decimals = 0;
+			}
+			else
+			{
+				break;
+			}
+
+			io_line.remove_prefix (1);
+		}
+
+		if (0 == digits)
+		{
+			return Scan::kBad;
+		}
+
+		if (decimals <= 0)
+		{
+			value *= 10;
+		}
+
+		o_tenths = negative ? -value : value;
+
+		return Scan::kWord;
+	}
+
+
+	/**
+	 * Applies a tracked modal word.
+	 *
+	 * @return GrblModalField the word sets, 0 for other words
+	 */
+	uint8_t ApplyWord (
+	    char            i_letter,
+	    int32_t         i_tenths,
+	    GrblModalState& io_state,
+	    bool&           o_changed) noexcept
+	{
+		auto const Set = [ &io_state, &o_changed ] (
+		                     uint8_t i_field, auto& io_member, auto i_value) {
+			o_changed =
+			    !(io_state.known & i_field) || (io_member != i_value);
+
+			io_member = i_value;
+			io_state.known |= i_field;
+
+			return i_field;
+		};
+
+		o_changed = false;
+
+		if ('G' != i_letter)
+		{
+			return 0;
+		}
+
+		switch (i_tenths)
+		{
+		case 200:
+			return Set (kModalUnits, io_state.inches, true);
+
+		case 210:
+			return Set (kModalUnits, io_state.inches, false);
+
+		case 900:
+			return Set (kModalDistance, io_state.incremental, false);
+
+		case 910:
+			return Set (kModalDistance, io_state.incremental, true);
+
+		case 540:
+		case 550:
+		case 560:
+		case 570:
+		case 580:
+		case 590:
+			return Set (
+			    kModalCoordinateSystem,
+			    io_state.coordinate_system,
+			    static_cast< uint8_t > ((i_tenths - 540) / 10));
+
+		case 921:
+			return Set (kModalG92, io_state.g92_active, false);
+
+		case 920: {
+			// Sets new offsets even when some are active already
+			Set (kModalG92, io_state.g92_active, true);
+
+			o_changed = true;
+
+			return kModalG92;
+		}
+
+		default:
+			return 0;
+		}
+	}
+} // namespace
+
+
+bool ParseGrblModalReport (
+    etl::string_view i_report,
+    GrblModalState&  io_state,
+    uint8_t          i_skip_fields) noexcept
+{
+	if (!i_report.starts_with ("[GC:"))
+	{
+		return false;
+	}
+
+	i_report.remove_prefix (sizeof ("[GC:") - 1);
+
+	if (!i_report.empty () && (']' == i_report.back ()))
+	{
+		i_report.remove_suffix (1);
+	}
+
+	auto reported = GrblModalState{};
+
+	char    letter;
+	int32_t tenths;
+	bool    changed;
+
+	for (;;)
+	{
+		auto const scan = NextWord (i_report, letter, tenths);
+
+		if (Scan::kBad == scan)
+		{
+			return false;
+		}
+
+		if (Scan::kEnd == scan)
+		{
+			break;
+		}
+
+		ApplyWord (letter, tenths, reported, changed);
+	}
+
+	auto const take = reported.known & ~i_skip_fields;
+
+	if (take & kModalCoordinateSystem)
+	{
+		io_state.coordinate_system = reported.coordinate_system;
+	}
+
+	if (take & kModalUnits)
+	{
+		io_state.inches = reported.inches;
+	}
+
+	if (take & kModalDistance)
+	{
+		io_state.incremental = reported.incremental;
+	}
+
+	io_state.known |= take;
+
+	return true;
+}
+
+
+bool ApplyGrblModalLine (
+    etl::string_view i_line,
+    GrblModalState&  io_state,
+    uint8_t*         o_changed_fields) noexcept
+{
+	// System commands leave the modes alone, $J= jogs included
+	if (i_line.starts_with ('$'))
+	{
+		return true;
+	}
+
+	auto state          = io_state;
+	auto changed_fields = uint8_t{0};
+	auto effective      = false;
+	auto words          = 0;
+
+	char    letter;
+	int32_t tenths;
+	bool    changed;
+
+	for (;;)
+	{
+		auto const scan = NextWord (i_line, letter, tenths);
+
+		if (Scan::kBad == scan)
+		{
+			// Grbl rejects the line, the modes stay
+			return true;
+		}
+
+		if (Scan::kEnd == scan)
+		{
+			break;
+		}
+
+		++words;
+
+		if ('N' == letter)
+		{
+			continue;
+		}
+
+		if (auto const field = ApplyWord (letter, tenths, state, changed);
+		    0 != field)
+		{
+			if (changed)
+			{
+				changed_fields |= field;
+				effective = true;
+			}
+		}
+		else if (('M' == letter) && ((20 == tenths) || (300 == tenths)))
+		{
+			// Program end restores G54 and G90
+			state.coordinate_system = 0;
+			state.incremental       = false;
+			state.known |= kModalCoordinateSystem | kModalDistance;
+
+			changed_fields |= kModalCoordinateSystem | kModalDistance;
+			effective = true;
+		}
+		else
+		{
+			effective = true;
+		}
+	}
+
+	io_state = state;
+
+	if (nullptr != o_changed_fields)
+	{
+		*o_changed_fields = changed_fields;
+	}
+
+	return effective || (0 == words);
+}
@@ -0,0 +1,58 @@
+#ifndef SRC_DEVICES_GRBLMODAL_HPP
+#define SRC_DEVICES_GRBLMODAL_HPP
+
+
+#include <cstdint>
+
+#include <etl/string_view.h>
+
+
+/// Modal groups whose state is known
+enum GrblModalField : uint8_t {
+	kModalCoordinateSystem = 1 << 0,
+	kModalUnits            = 1 << 1,
+	kModalDistance         = 1 << 2,
+	kModalG92              = 1 << 3,
+};
+
+
+/**
+ * Parser modes of the controller, from $G replies and the lines sent.
+ * Values are meaningful only when their GrblModalField bit is set in known.
+ */
+struct GrblModalState {
+	uint8_t coordinate_system{0}; ///< 0 for G54 up to 5 for G59
+	bool    inches{false};        ///< G20, G21 otherwise
+	bool    incremental{false};   ///< G91, G90 otherwise
+	bool    g92_active{false};    ///< G92 offsets set and not cleared
+
+	uint8_t known{0}; ///< GrblModalField bits
+};
+
+
+/**
+ * Updates the state from a "[GC:G0 G54 G17 G21 G90 G94 M5 M9 T0 F0 S0]"
+ * reply. Only the fields not in i_skip_fields are taken, those were
+ * changed by lines sent after $G.
+ *
+ * @return false if the reply is malformed
+ */
+bool ParseGrblModalReport (
+    etl::string_view i_report,
+    GrblModalState&  io_state,
+    uint8_t          i_skip_fields = 0) noexcept;
+
+
+/**
+ * Applies the modal words of a G-code line about to be sent.
+ *
+ * @return false if the line only sets modes that are known to be set
+ *         already, so sending it changes nothing
+ */
+bool ApplyGrblModalLine (
+    etl::string_view i_line,
+    GrblModalState&  io_state,
+    uint8_t*         o_changed_fields = nullptr) noexcept;
+
+
+#endif // SRC_DEVICES_GRBLMODAL_HPP
@@ -0,0 +1,234 @@
+#include "GrblOverrides.hpp"
+
+
+#include <cstdlib>
+
+
+namespace {
+	// Grbl 1.1 realtime override commands
+	struct StepCodes {
+		char reset;
+		char coarse_plus;
+		char coarse_minus;
+		char fine_plus;
+		char fine_minus;
+	};
+
+
+	StepCodes constexpr kFeedCodes{'\x90', '\x91', '\x92', '\x93', '\x94'};
+	StepCodes constexpr kSpindleCodes{'\x99', '\x9A', '\x9B', '\x9C', '\x9D'};
+
+	char constexpr kRapidFull    = '\x95';
+	char constexpr kRapidHalf    = '\x96';
+	char constexpr kRapidQuarter = '\x97';
+
+	int constexpr kMinPercent          = 10;
+	int constexpr kMaxPercent          = 200;
+	int constexpr kCoarseStep          = 10;
+	int constexpr kRapidHalfPercent    = 50;
+	int constexpr kRapidQuarterPercent = 25;
+
+	int constexpr kNoPlan = 1000; ///< Longer than any real plan
+
+
+	struct Plan {
+		int  length{kNoPlan};
+		char first{0};
+	};
+
+
+	bool WithinLimits (int i_percent)
+	{
+		return i_percent >= kMinPercent && i_percent <= kMaxPercent;
+	}
+
+
+	/**
+	 * Shortest run of coarse steps one way and fine steps either way. The
+	 * fine steps go first when the coarse ones would leave the limits.
+	 */
+	Plan PlanSteps (const StepCodes& i_codes, int i_current, int i_target)
+	{
+		auto const delta = i_target - i_current;
+
+		// Coarse step counts rounding the delta down and up
+		int const coarse_counts[] = {
+		    delta / kCoarseStep - (delta % kCoarseStep < 0 ? 1 : 0),
+		    delta / kCoarseStep + (delta % kCoarseStep > 0 ? 1 : 0)};
+
+		auto plan = Plan{};
+
+		for (auto const coarse : coarse_counts)
+		{
+			auto const fine   = delta - coarse * kCoarseStep;
+			auto const length = abs (coarse) + abs (fine);
+
+			// Values in between are within the limits when both ends are
+			auto const coarse_first =
+			    WithinLimits (i_current + coarse * kCoarseStep);
+			auto const fine_first = WithinLimits (i_current + fine);
+
+			if ((length >= plan.length) || !(coarse_first || fine_first))
+			{
+				continue;
+			}
+
+			plan.length = length;
+
+			if ((0 != coarse) && coarse_first)
+			{
+				plan.first =
+				    coarse > 0 ? i_codes.coarse_plus : i_codes.coarse_minus;
+			}
+			else if (0 != fine)
+			{
+				plan.first = fine > 0 ? i_codes.fine_plus : i_codes.fine_minus;
+			}
+			else
+			{
+				plan.first = 0;
+			}
+		}
+
+		return plan;
+	}
+
+
+	const StepCodes& CodesOf (GrblOverride i_override)
+	{
+		return GrblOverride::kSpindle == i_override ? kSpindleCodes
+		                                            : kFeedCodes;
+	}
+} // namespace
+
+
+uint8_t GrblOverrideClamp (GrblOverride i_override, int i_percent) noexcept
+{
+	if (GrblOverride::kRapid == i_override)
+	{
+		if (i_percent >= (kGrblOverrideDefault + kRapidHalfPercent) / 2)
+		{
+			return kGrblOverrideDefault;
+		}
+
+		return i_percent >= (kRapidHalfPercent + kRapidQuarterPercent) / 2
+		    ? kRapidHalfPercent
+		    : kRapidQuarterPercent;
+	}
+
+	if (i_percent < kMinPercent)
+	{
+		return kMinPercent;
+	}
+
+	return i_percent > kMaxPercent ? kMaxPercent : i_percent;
+}
+
+
+char GrblOverrideNextByte (
+    GrblOverride i_override, uint8_t i_current, uint8_t i_target) noexcept
+{
+	i_target = GrblOverrideClamp (i_override, i_target);
+
+	if (i_current == i_target)
+	{
+		return 0;
+	}
+
+	if (GrblOverride::kRapid == i_override)
+	{
+		switch (i_target)
+		{
+		case kRapidHalfPercent:
+			return kRapidHalf;
+
+		case kRapidQuarterPercent:
+			return kRapidQuarter;
+
+		default:
+			return kRapidFull;
+		}
+	}
+
+	auto const& codes = CodesOf (i_override);
+
+	auto const direct = PlanSteps (codes, i_current, i_target);
+	auto const after_reset =
+	    PlanSteps (codes, kGrblOverrideDefault, i_target);
+
+	// The reset costs a byte too
+	if (after_reset.length + 1 < direct.length)
+	{
+		return codes.reset;
+	}
+
+	return direct.first;
+}
+
+
+uint8_t GrblOverrideApply (
+    GrblOverride i_override, uint8_t i_current, char i_byte) noexcept
+{
+	if (GrblOverride::kRapid == i_override)
+	{
+		switch (i_byte)
+		{
+		case kRapidFull:
+			return kGrblOverrideDefault;
+
+		case kRapidHalf:
+			return kRapidHalfPercent;
+
+		case kRapidQuarter:
+			return kRapidQuarterPercent;
+
+		default:
+			return i_current;
+		}
+	}
+
+	auto const& codes = CodesOf (i_override);
+
+	auto value = int{i_current};
+
+	if (codes.reset == i_byte)
+	{
+		value = kGrblOverrideDefault;
+	}
+	else if (codes.coarse_plus == i_byte)
+	{
+		value += kCoarseStep;
+	}
+	else if (codes.coarse_minus == i_byte)
+	{
+		value -= kCoarseStep;
+	}
+	else if (codes.fine_plus == i_byte)
+	{
+		value += 1;
+	}
+	else if (codes.fine_minus == i_byte)
+	{
+		value -= 1;
+	}
+
+	return GrblOverrideClamp (i_override, value);
+}
+
+
+const char* GrblOverrideName (GrblOverride i_override) noexcept
+{
+	switch (i_override)
+	{
+	case GrblOverride::kFeed:
+		return "feed";
+
+	case GrblOverride::kRapid:
+		return "rapid";
+
+	case GrblOverride::kSpindle:
+		return "spindle";
+	}
+
+	return "";
+}
@@ -0,0 +1,51 @@
+#ifndef SRC_DEVICES_GRBLOVERRIDES_HPP
+#define SRC_DEVICES_GRBLOVERRIDES_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+
+
+enum class GrblOverride : uint8_t {
+	kFeed,
+	kRapid,
+	kSpindle,
+};
+
+
+static size_t constexpr kGrblOverrideCount = 3;
+
+/// Value after reset and after the "set 100%" commands
+static uint8_t constexpr kGrblOverrideDefault = 100;
+
+
+/**
+ * Limits the percentage to what Grbl accepts: 10-200 for feed and spindle,
+ * the nearest of 25, 50 and 100 for rapids.
+ */
+uint8_t GrblOverrideClamp (GrblOverride i_override, int i_percent) noexcept;
+
+
+/**
+ * First realtime byte of the shortest byte sequence that takes the override
+ * from i_current to i_target, 0 if there is nothing to do. Calling it again
+ * with the value the byte leads to yields the next byte of the sequence.
+ *
+ * Coarse (10%) and fine (1%) steps are combined, overshooting with a coarse
+ * step and going back with fine ones when that is shorter, and a reset to
+ * 100% is used first when it saves bytes. No step runs into Grbl's limits,
+ * where it would be clamped and the rest of the sequence would miss.
+ */
+char GrblOverrideNextByte (
+    GrblOverride i_override, uint8_t i_current, uint8_t i_target) noexcept;
+
+
+/// Override value after Grbl applies the realtime byte
+uint8_t GrblOverrideApply (
+    GrblOverride i_override, uint8_t i_current, char i_byte) noexcept;
+
+
+const char* GrblOverrideName (GrblOverride i_override) noexcept;
+
+
+#endif // SRC_DEVICES_GRBLOVERRIDES_HPP
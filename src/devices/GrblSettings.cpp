@@ -0,0 +1,176 @@
+#include "GrblSettings.hpp"
+
+
+#include <stdlib.h>
+
+#include <etl/algorithm.h>
+
+
+namespace {
+	bool IsDigit (char i_c)
+	{
+		return i_c >= '0' && i_c <= '9';
+	}
+
+
+	/// Parses a whole number at the front of the view
+	bool ConsumeNumber (etl::string_view& io_view, uint16_t& o_number)
+	{
+		auto number = uint32_t{0};
+		auto length = size_t{0};
+
+		while ((length < io_view.size ()) && IsDigit (io_view[ length ]) &&
+		       (number <= UINT16_MAX))
+		{
+			number = number * 10 + (io_view[ length ] - '0');
+
+			++length;
+		}
+
+		if ((0 == length) || (number > UINT16_MAX))
+		{
+			return false;
+		}
+
+		o_number = static_cast< uint16_t > (number);
+
+		io_view.remove_prefix (length);
+
+		return true;
+	}
+} // namespace
+
+
+bool GrblSettings::ParseLine (etl::string_view i_line) noexcept
+{
+	//$110=500.000
+	//$0=10 (step pulse, usec)   Grbl 0.9
+
+	auto number = uint16_t{};
+
+	if (i_line.empty () || ('$' != i_line[ 0 ]))
+	{
+		return false;
+	}
+
+	i_line.remove_prefix (1);
+
+	if (!ConsumeNumber (i_line, number) || i_line.empty () ||
+	    ('=' != i_line[ 0 ]))
+	{
+		return false;
+	}
+
+	i_line.remove_prefix (1);
+
+	// Values are short, a copy makes the view zero-terminated for strtof
+	char value_str[ 24 ]{};
+
+	auto const length = etl::min (i_line.size (), sizeof (value_str) - 1);
+
+	etl::copy_n (i_line.data (), length, value_str);
+
+	char*      end   = nullptr;
+	auto const value = strtof (value_str, &end);
+
+	if (end == value_str)
+	{
+		return false; // Not numeric, e.g. a grblHAL string setting
+	}
+
+	auto const entry = etl::lower_bound (
+	    entries_.begin (),
+	    entries_.end (),
+	    number,
+	    [] (const Entry& i_entry, uint16_t i_key) {
+		    return i_entry.number < i_key;
+	    });
+
+	if ((entries_.end () != entry) && (number == entry->number))
+	{
+		entry->value = value;
+	}
+	else if (!entries_.full ())
+	{
+		entries_.insert (entry, Entry{number, value});
+	}
+
+	return true;
+}
+
+
+bool GrblSettings::Has (uint16_t i_number) const noexcept
+{
+	return nullptr != Find (i_number);
+}
+
+
+float GrblSettings::Get (uint16_t i_number, float i_default) const noexcept
+{
+	auto const entry = Find (i_number);
+
+	return nullptr != entry ? entry->value : i_default;
+}
+
+
+bool GrblSettings::TravelRange (
+    size_t i_axis, float& o_min, float& o_max) const noexcept
+{
+	auto const travel = Get (kSettingMaxTravel + i_axis);
+
+	if ((0 == Get (kSettingSoftLimits)) || (travel <= 0.0f))
+	{
+		return false;
+	}
+
+	auto const inverted =
+	    static_cast< uint32_t > (Get (kSettingHomingDirMask)) & (1 << i_axis);
+
+	o_min = inverted ? 0.0f : -travel;
+	o_max = inverted ? travel : 0.0f;
+
+	return true;
+}
+
+
+const GrblSettings::Entry* GrblSettings::Find (
+    uint16_t i_number) const noexcept
+{
+	auto const entry = etl::lower_bound (
+	    entries_.begin (),
+	    entries_.end (),
+	    i_number,
+	    [] (const Entry& i_entry, uint16_t i_key) {
+		    return i_entry.number < i_key;
+	    });
+
+	if ((entries_.end () != entry) && (i_number == entry->number))
+	{
+		return &*entry;
+	}
+
+	return nullptr;
+}
+
+
+bool IsGrblSettingsWrite (etl::string_view i_command) noexcept
+{
+	//$110=1000   $RST=*   but not $J=... or $N0=...
+
+	if (i_command.starts_with ("$RST="))
+	{
+		return true;
+	}
+
+	if (i_command.empty () || ('$' != i_command[ 0 ]))
+	{
+		return false;
+	}
+
+	i_command.remove_prefix (1);
+
+	auto number = uint16_t{};
+
+	return ConsumeNumber (i_command, number) && !i_command.empty () &&
+	    ('=' == i_command[ 0 ]);
+}
@@ -0,0 +1,92 @@
+#ifndef SRC_DEVICES_GRBLSETTINGS_HPP
+#define SRC_DEVICES_GRBLSETTINGS_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <etl/string_view.h>
+#include <etl/vector.h>
+
+
+/// Numbers of the $ settings the pendant uses
+enum GrblSetting : uint16_t {
+	kSettingSoftLimits    = 20,
+	kSettingHomingDirMask = 23,
+	kSettingMaxRate       = 110, ///< + axis, units/min
+	kSettingAcceleration  = 120, ///< + axis, units/s^2
+	kSettingMaxTravel     = 130, ///< + axis, units
+};
+
+
+/**
+ * Numeric values of the $$ settings, sorted by setting number. Settings
+ * that do not fit are dropped; axis settings of the stock Grbl numbering
+ * always fit.
+ */
+class GrblSettings {
+public:
+	/// Takes a "$110=500.000" line, false if the line is not a setting
+	bool ParseLine (etl::string_view i_line) noexcept;
+
+	void Clear () noexcept
+	{
+		entries_.clear ();
+	}
+
+	bool Empty () const noexcept
+	{
+		return entries_.empty ();
+	}
+
+	size_t Size () const noexcept
+	{
+		return entries_.size ();
+	}
+
+	bool Has (uint16_t i_number) const noexcept;
+
+	float Get (uint16_t i_number, float i_default = 0.0f) const noexcept;
+
+
+	/// 0 if unknown
+	float MaxRate (size_t i_axis) const noexcept
+	{
+		return Get (kSettingMaxRate + i_axis);
+	}
+
+	/// 0 if unknown
+	float Acceleration (size_t i_axis) const noexcept
+	{
+		return Get (kSettingAcceleration + i_axis);
+	}
+
+	/**
+	 * Machine coordinate range the soft limits allow for the axis. Grbl
+	 * homes to the positive end unless the homing direction is inverted.
+	 *
+	 * @return false if soft limits are off or the travel is unknown
+	 */
+	bool TravelRange (
+	    size_t i_axis, float& o_min, float& o_max) const noexcept;
+
+
+private:
+	static size_t constexpr kCapacity = 96;
+
+	struct Entry {
+		uint16_t number;
+		float    value;
+	};
+
+	etl::vector< Entry, kCapacity > entries_;
+
+	const Entry* Find (uint16_t i_number) const noexcept;
+};
+
+
+/// Whether the command changes settings, so the cached ones are stale
+bool IsGrblSettingsWrite (etl::string_view i_command) noexcept;
+
+
+#endif // SRC_DEVICES_GRBLSETTINGS_HPP
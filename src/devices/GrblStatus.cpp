@@ -0,0 +1,473 @@
+#include "GrblStatus.hpp"
+
+
+namespace {
+	struct StateName {
+		const char* name;
+		GrblState   state;
+	};
+
+
+	StateName constexpr kStateNames[] = {
+	    {"Idle", GrblState::kIdle},
+	    {"Run", GrblState::kRun},
+	    {"Hold", GrblState::kHold},
+	    {"Jog", GrblState::kJog},
+	    {"Alarm", GrblState::kAlarm},
+	    {"Door", GrblState::kDoor},
+	    {"Check", GrblState::kCheck},
+	    {"Home", GrblState::kHome},
+	    {"Sleep", GrblState::kSleep},
+	    {"Tool", GrblState::kTool},
+	};
+
+
+	struct PinLetter {
+		char     letter;
+		uint16_t pin;
+	};
+
+
+	PinLetter constexpr kPinLetters[] = {
+	    {'X', kPinX},
+	    {'Y', kPinY},
+	    {'Z', kPinZ},
+	    {'A', kPinA},
+	    {'B', kPinB},
+	    {'C', kPinC},
+	    {'P', kPinProbe},
+	    {'D', kPinDoor},
+	    {'H', kPinHold},
+	    {'R', kPinSoftReset},
+	    {'S', kPinCycleStart},
+	    {'E', kPinEStop},
+	};
+
+
+	/**
+	 * Consumes a decimal number like "-12.345" from the front of the view.
+	 * Grbl never sends exponents, so none are accepted. The view does not
+	 * have to be zero-terminated.
+	 */
+	bool ConsumeNumber (etl::string_view& io_view, float& o_value) noexcept
+	{
+		auto       position = size_t{0};
+		auto const negative = !io_view.empty () && '-' == io_view[ 0 ];
+
+		if (negative || (!io_view.empty () && '+' == io_view[ 0 ]))
+		{
+			++position;
+		}
+
+		auto value    = 0.0f;
+		auto scale    = 1.0f;
+		auto digits   = 0;
+		auto fraction = false;
+
+		for (; position < io_view.size (); ++position)
+		{
+			auto const c = io_view[ position ];
+
+			if (c >= '0' && c <= '9')
+			{
+				if (fraction)
+				{
+					scale *= 0.1f;
+					value += (c - '0') * scale;
+				}
+				else
+				{
+					value = value * 10.0f + (c - '0');
+				}
+
+				++digits;
+			}
+			else if ('.' == c && !fraction)
+			{
+				fraction = true;
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		if (0 == digits)
+		{
+			return false;
+		}
+
+		o_value = negative ? -value : value;
+
+		io_view.remove_prefix (position);
+
+		return true;
+	}
+
+
+	/// Parses "v1,v2,..." filling exactly i_count values
+	bool ParseNumbers (
+	    etl::string_view i_view, float* o_values, size_t i_count) noexcept
+	{
+		for (size_t i = 0; i < i_count; ++i)
+		{
+			if (0 != i)
+			{
+				if (i_view.empty () || ',' != i_view[ 0 ])
+				{
+					return false;
+				}
+
+				i_view.remove_prefix (1);
+			}
+
+			if (!ConsumeNumber (i_view, o_values[ i ]))
+			{
+				return false;
+			}
+		}
+
+		// grblHAL may report more axes than the pendant knows about
+		return i_view.empty () || ',' == i_view[ 0 ];
+	}
+
+
+	bool ParsePosition (etl::string_view i_view, Vector3f& o_position) noexcept
+	{
+		float values[ 3 ];
+
+		if (!ParseNumbers (i_view, values, 3))
+		{
+			return false;
+		}
+
+		o_position = Vector3f{values[ 0 ], values[ 1 ], values[ 2 ]};
+
+		return true;
+	}
+
+
+	bool ParseState (etl::string_view i_view, GrblStatus& io_status) noexcept
+	{
+		auto name = i_view;
+
+		io_status.substate = -1;
+
+		if (auto const colon = i_view.find (':');
+		    etl::string_view::npos != colon)
+		{
+			name = i_view.substr (0, colon);
+
+			auto substate = i_view.substr (colon + 1);
+			auto value    = 0.0f;
+
+			if (ConsumeNumber (substate, value))
+			{
+				io_status.substate = static_cast< int8_t > (value);
+			}
+		}
+
+		for (auto const& state_name : kStateNames)
+		{
+			if (name == state_name.name)
+			{
+				io_status.state = state_name.state;
+
+				return true;
+			}
+		}
+
+		io_status.state = GrblState::kUnknown;
+
+		return false;
+	}
+
+
+	void ParsePins (etl::string_view i_view, GrblStatus& io_status) noexcept
+	{
+		for (auto const letter : i_view)
+		{
+			io_status.pins |= GrblPinFromLetter (letter);
+		}
+	}
+
+
+	void ParseAccessories (
+	    etl::string_view i_view, GrblStatus& io_status) noexcept
+	{
+		for (auto const letter : i_view)
+		{
+			switch (letter)
+			{
+			case 'S': io_status.accessories |= kAccessorySpindleCw; break;
+			case 'C': io_status.accessories |= kAccessorySpindleCcw; break;
+			case 'F': io_status.accessories |= kAccessoryFlood; break;
+			case 'M': io_status.accessories |= kAccessoryMist; break;
+			default: break;
+			}
+		}
+	}
+
+
+	bool ParseField (etl::string_view i_field, GrblStatus& io_status) noexcept
+	{
+		auto const colon = i_field.find (':');
+
+		if (etl::string_view::npos == colon)
+		{
+			return true; // Unknown flag, e.g. from a grblHAL plugin
+		}
+
+		auto const name  = i_field.substr (0, colon);
+		auto const value = i_field.substr (colon + 1);
+
+		float numbers[ 3 ];
+
+		if ("MPos" == name)
+		{
+			io_status.fields |= kFieldMPos;
+
+			return ParsePosition (value, io_status.machine_position);
+		}
+		else if ("WPos" == name)
+		{
+			io_status.fields |= kFieldWPos;
+
+			return ParsePosition (value, io_status.work_position);
+		}
+		else if ("WCO" == name)
+		{
+			io_status.fields |= kFieldWco;
+
+			return ParsePosition (value, io_status.work_coordinate_offset);
+		}
+		else if ("FS" == name)
+		{
+			if (!ParseNumbers (value, numbers, 2))
+			{
+				return false;
+			}
+
+			io_status.feed          = numbers[ 0 ];
+			io_status.spindle_speed = static_cast< uint32_t > (numbers[ 1 ]);
+			io_status.fields |= kFieldFeed | kFieldSpindle;
+		}
+		else if ("F" == name)
+		{
+			if (!ParseNumbers (value, numbers, 1))
+			{
+				return false;
+			}
+
+			io_status.feed = numbers[ 0 ];
+			io_status.fields |= kFieldFeed;
+		}
+		else if ("Bf" == name)
+		{
+			if (!ParseNumbers (value, numbers, 2))
+			{
+				return false;
+			}
+
+			io_status.planner_blocks_free =
+			    static_cast< uint16_t > (numbers[ 0 ]);
+			io_status.rx_bytes_free = static_cast< uint16_t > (numbers[ 1 ]);
+			io_status.fields |= kFieldBuffer;
+		}
+		else if ("Ln" == name)
+		{
+			if (!ParseNumbers (value, numbers, 1))
+			{
+				return false;
+			}
+
+			io_status.line_number = static_cast< int32_t > (numbers[ 0 ]);
+			io_status.fields |= kFieldLineNumber;
+		}
+		else if ("Ov" == name)
+		{
+			if (!ParseNumbers (value, numbers, 3))
+			{
+				return false;
+			}
+
+			io_status.feed_override    = static_cast< uint8_t > (numbers[ 0 ]);
+			io_status.rapid_override   = static_cast< uint8_t > (numbers[ 1 ]);
+			io_status.spindle_override = static_cast< uint8_t > (numbers[ 2 ]);
+			io_status.fields |= kFieldOverrides;
+		}
+		else if ("Pn" == name)
+		{
+			ParsePins (value, io_status);
+
+			io_status.fields |= kFieldPins;
+		}
+		else if ("A" == name)
+		{
+			io_status.accessories = 0;
+
+			ParseAccessories (value, io_status);
+
+			io_status.fields |= kFieldAccessories;
+		}
+
+		return true;
+	}
+} // namespace
+
+
+bool ParseGrblStatus (
+    etl::string_view i_report, GrblStatus& io_status) noexcept
+{
+	//<Idle|MPos:9.800,0.000,0.000|FS:0,0|WCO:0.000,0.000,0.000>
+	//<Hold:0|WPos:1.000,2.000,0.000|Bf:15,128|FS:0,0|Pn:XP|Ov:100,100,100|A:SF>
+
+	if (i_report.empty () || '<' != i_report.front ())
+	{
+		return false;
+	}
+
+	i_report.remove_prefix (1);
+
+	if (!i_report.empty () && '>' == i_report.back ())
+	{
+		i_report.remove_suffix (1);
+	}
+
+	auto status = io_status;
+
+	/*
+	  Pins and accessories are only reported while active, the line number
+	  only while a numbered line is executing.
+	*/
+	status.pins        = 0;
+	status.line_number = -1;
+	status.fields      = 0;
+
+	auto first = true;
+
+	while (!i_report.empty ())
+	{
+		auto const separator = i_report.find ('|');
+		auto const field     = i_report.substr (0, separator);
+
+		if (first)
+		{
+			if (!ParseState (field, status))
+			{
+				return false;
+			}
+
+			first = false;
+		}
+		else if (!ParseField (field, status))
+		{
+			return false;
+		}
+
+		if (etl::string_view::npos == separator)
+		{
+			break;
+		}
+
+		i_report.remove_prefix (separator + 1);
+	}
+
+	if (!(status.fields & (kFieldMPos | kFieldWPos)))
+	{
+		return false;
+	}
+
+	// A: comes together with Ov:, missing A: then means all accessories off
+	if ((status.fields & kFieldOverrides) &&
+	    !(status.fields & kFieldAccessories))
+	{
+		status.accessories = 0;
+	}
+
+	auto const& wco = status.work_coordinate_offset;
+
+	if (status.fields & kFieldMPos)
+	{
+		auto const& mpos = status.machine_position;
+
+		status.work_position =
+		    Vector3f{mpos.x - wco.x, mpos.y - wco.y, mpos.z - wco.z};
+	}
+	else
+	{
+		auto const& wpos = status.work_position;
+
+		status.machine_position =
+		    Vector3f{wpos.x + wco.x, wpos.y + wco.y, wpos.z + wco.z};
+	}
+
+	io_status = status;
+
+	return true;
+}
+
+
+bool ParseGrblProbeResult (
+    etl::string_view i_reply, GrblProbeResult& o_result) noexcept
+{
+	if (!i_reply.starts_with ("[PRB:") || !i_reply.ends_with (']'))
+	{
+		return false;
+	}
+
+	i_reply.remove_prefix (sizeof ("[PRB:") - 1);
+	i_reply.remove_suffix (1);
+
+	auto const flag_start = i_reply.rfind (':');
+
+	if (etl::string_view::npos == flag_start)
+	{
+		return false;
+	}
+
+	auto const flag = i_reply.substr (flag_start + 1);
+
+	if (("0" != flag) && ("1" != flag))
+	{
+		return false;
+	}
+
+	if (!ParsePosition (
+	        i_reply.substr (0, flag_start), o_result.machine_position))
+	{
+		return false;
+	}
+
+	o_result.success = ("1" == flag);
+
+	return true;
+}
+
+
+const char* GrblStateName (GrblState i_state) noexcept
+{
+	for (auto const& state_name : kStateNames)
+	{
+		if (i_state == state_name.state)
+		{
+			return state_name.name;
+		}
+	}
+
+	return "?";
+}
+
+
+uint16_t GrblPinFromLetter (char i_letter) noexcept
+{
+	for (auto const& pin_letter : kPinLetters)
+	{
+		if (i_letter == pin_letter.letter)
+		{
+			return pin_letter.pin;
+		}
+	}
+
+	return 0;
+}
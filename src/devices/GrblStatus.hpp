@@ -0,0 +1,134 @@
+#ifndef SRC_DEVICES_GRBLSTATUS_HPP
+#define SRC_DEVICES_GRBLSTATUS_HPP
+
+
+#include <cstdint>
+
+#include <etl/string_view.h>
+
+#include "../VectorND.hpp"
+
+
+enum class GrblState : uint8_t {
+	kUnknown,
+	kIdle,
+	kRun,
+	kHold,
+	kJog,
+	kAlarm,
+	kDoor,
+	kCheck,
+	kHome,
+	kSleep,
+	kTool, ///< grblHAL tool change
+};
+
+
+/// Input pin bits, as reported in the Pn: field
+enum GrblPin : uint16_t {
+	kPinX          = 1 << 0,
+	kPinY          = 1 << 1,
+	kPinZ          = 1 << 2,
+	kPinA          = 1 << 3,
+	kPinB          = 1 << 4,
+	kPinC          = 1 << 5,
+	kPinProbe      = 1 << 6,
+	kPinDoor       = 1 << 7,
+	kPinHold       = 1 << 8,
+	kPinSoftReset  = 1 << 9,
+	kPinCycleStart = 1 << 10,
+	kPinEStop      = 1 << 11, ///< grblHAL
+};
+
+
+/// Accessory bits, as reported in the A: field
+enum GrblAccessory : uint8_t {
+	kAccessorySpindleCw  = 1 << 0,
+	kAccessorySpindleCcw = 1 << 1,
+	kAccessoryFlood      = 1 << 2,
+	kAccessoryMist       = 1 << 3,
+};
+
+
+/// Fields present in the last status report
+enum GrblStatusField : uint16_t {
+	kFieldMPos        = 1 << 0,
+	kFieldWPos        = 1 << 1,
+	kFieldWco         = 1 << 2,
+	kFieldBuffer      = 1 << 3,
+	kFieldLineNumber  = 1 << 4,
+	kFieldFeed        = 1 << 5,
+	kFieldSpindle     = 1 << 6,
+	kFieldOverrides   = 1 << 7,
+	kFieldPins        = 1 << 8,
+	kFieldAccessories = 1 << 9,
+};
+
+
+/**
+ * Machine state decoded from Grbl status reports.
+ *
+ * Grbl sends some fields only from time to time (WCO, Ov) or only when they
+ * are not empty (Pn, A), so values of fields missing from a report are kept
+ * or reset the way Grbl documents them. Both positions are always valid:
+ * the one that is not reported is derived using the last known WCO.
+ */
+struct GrblStatus {
+	GrblState state{GrblState::kUnknown};
+	int8_t    substate{-1}; ///< Hold:0, Door:1..., -1 if not reported
+
+	Vector3f machine_position;
+	Vector3f work_position;
+	Vector3f work_coordinate_offset;
+
+	float    feed{};
+	uint32_t spindle_speed{};
+
+	uint16_t pins{};        ///< GrblPin bits
+	uint8_t  accessories{}; ///< GrblAccessory bits
+
+	uint8_t feed_override{100};
+	uint8_t rapid_override{100};
+	uint8_t spindle_override{100};
+
+	uint16_t planner_blocks_free{};
+	uint16_t rx_bytes_free{};
+	int32_t  line_number{-1}; ///< -1 if not reported
+
+	uint16_t fields{}; ///< GrblStatusField bits of the last report
+};
+
+
+/**
+ * Updates the status from a "<...>" report without allocating.
+ *
+ * @return false if the report is malformed; the status is not changed then.
+ */
+bool ParseGrblStatus (
+    etl::string_view i_report, GrblStatus& io_status) noexcept;
+
+
+/// A [PRB:] reply
+struct GrblProbeResult {
+	Vector3f machine_position; ///< Where the probe stopped
+	bool     success{false};   ///< Contact made
+};
+
+
+/**
+ * Takes a "[PRB:0.000,0.000,-1.234:1]" reply.
+ *
+ * @return false if the reply is malformed
+ */
+bool ParseGrblProbeResult (
+    etl::string_view i_reply, GrblProbeResult& o_result) noexcept;
+
+
+const char* GrblStateName (GrblState i_state) noexcept;
+
+
+/// Pin bit for an axis or pin letter of the Pn: field, 0 if there is none
+uint16_t GrblPinFromLetter (char i_letter) noexcept;
+
+
+#endif // SRC_DEVICES_GRBLSTATUS_HPP
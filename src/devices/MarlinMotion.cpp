@@ -0,0 +1,346 @@
+#include "MarlinMotion.hpp"
+
+
+#include <math.h>
+
+
+namespace {
+	/// Marlin takes words with or without spaces between them, "G1X10Y5"
+	bool NextWord (
+	    etl::string_view& io_line,
+	    char&             o_letter,
+	    float&            o_value,
+	    bool&             o_has_value) noexcept
+	{
+		while (!io_line.empty () && (' ' == io_line[ 0 ]))
+		{
+			io_line.remove_prefix (1);
+		}
+
+		// A comment or the checksum ends the command
+		if (io_line.empty () || (';' == io_line[ 0 ]) || ('*' == io_line[ 0 ]))
+		{
+			return false;
+		}
+
+		o_letter = io_line[ 0 ];
+
+		if (o_letter >= 'a' && o_letter <= 'z')
+		{
+			o_letter -= 'a' - 'A';
+		}
+
+		io_line.remove_prefix (1);
+
+		auto const negative = !io_line.empty () && ('-' == io_line[ 0 ]);
+
+		if (negative || (!io_line.empty () && ('+' == io_line[ 0 ])))
+		{
+			io_line.remove_prefix (1);
+		}
+
+		auto value    = 0.0f;
+		auto scale    = 1.0f;
+		auto digits   = 0;
+		auto fraction = false;
+
+		while (!io_line.empty ())
+		{
+			auto const c = io_line[ 0 ];
+
+			if (c >= '0' && c <= '9')
+			{
+				if (fraction)
+				{
+					scale *= 0.1f;
+					value += (c - '0') * scale;
+				}
+				else
+				{
+					value = value * 10.0f + (c - '0');
+				}
+
+				++digits;
+			}
+			else if ('.' == c && !fraction)
+			{
+				fraction = true;
+			}
+			else
+			{
+				break;
+			}
+
+			io_line.remove_prefix (1);
+		}
+
+		o_value     = negative ? -value : value;
+		o_has_value = digits > 0;
+
+		return true;
+	}
+
+
+	uint8_t constexpr kLinearAxes = kMarlinAllAxes & ~(1 << kMarlinAxisE);
+
+
+	/// Axis words of the command
+	struct AxisWords {
+		float   value[ kMarlinAxisCount ]{};
+		uint8_t seen{0};       ///< Bit n for the letter of axis n
+		uint8_t with_value{0}; ///< Bit n if it had a number
+	};
+
+
+	int AxisOfLetter (char i_letter) noexcept
+	{
+		switch (i_letter)
+		{
+		case 'X':
+			return kMarlinAxisX;
+
+		case 'Y':
+			return kMarlinAxisY;
+
+		case 'Z':
+			return kMarlinAxisZ;
+
+		case 'E':
+			return kMarlinAxisE;
+
+		default:
+			return -1;
+		}
+	}
+
+
+	uint8_t Forget (uint8_t i_axes, MarlinMotionState& io_state) noexcept
+	{
+		auto const forgotten = io_state.known & i_axes;
+
+		io_state.known &= ~i_axes;
+
+		return forgotten;
+	}
+
+
+	uint8_t Move (
+	    const AxisWords& i_words, MarlinMotionState& io_state) noexcept
+	{
+		uint8_t changed = 0;
+
+		for (int axis = 0; axis < kMarlinAxisCount; ++axis)
+		{
+			uint8_t const bit = 1 << axis;
+
+			if (!(i_words.with_value & bit))
+			{
+				continue;
+			}
+
+			auto const millimetres =
+			    io_state.inches ? i_words.value[ axis ] * 25.4f
+			                    : i_words.value[ axis ];
+
+			auto const relative = (kMarlinAxisE == axis) ? io_state.relative_e
+			                                             : io_state.relative;
+
+			if (!relative)
+			{
+				io_state.position[ axis ] = millimetres;
+				io_state.known |= bit;
+				changed |= bit;
+			}
+			else if ((io_state.known & bit) && (0.0f != millimetres))
+			{
+				io_state.position[ axis ] += millimetres;
+				changed |= bit;
+			}
+		}
+
+		return changed;
+	}
+
+
+	/// Sets the position without moving, G92 E0 at the start of each layer
+	uint8_t SetPosition (
+	    const AxisWords& i_words, MarlinMotionState& io_state) noexcept
+	{
+		for (int axis = 0; axis < kMarlinAxisCount; ++axis)
+		{
+			if (i_words.with_value & (1 << axis))
+			{
+				io_state.position[ axis ] = io_state.inches
+				    ? i_words.value[ axis ] * 25.4f
+				    : i_words.value[ axis ];
+			}
+		}
+
+		io_state.known |= i_words.with_value;
+
+		return i_words.with_value;
+	}
+
+
+	uint8_t ApplyG (
+	    int32_t            i_tenths,
+	    const AxisWords&   i_words,
+	    MarlinMotionState& io_state) noexcept
+	{
+		switch (i_tenths)
+		{
+		case 0:
+		case 10:
+		case 20:
+		case 30:
+		case 50:
+			return Move (i_words, io_state);
+
+		case 200:
+			io_state.inches = true;
+			return 0;
+
+		case 210:
+			io_state.inches = false;
+			return 0;
+
+		case 900:
+			io_state.relative   = false;
+			io_state.relative_e = false;
+			return 0;
+
+		case 910:
+			io_state.relative   = true;
+			io_state.relative_e = true;
+			return 0;
+
+		case 920:
+		case 929:
+			return SetPosition (i_words, io_state);
+
+		// Homes the axes named, all of them if none is
+		case 280:
+			return Forget (
+			    (i_words.seen & kLinearAxes) ? i_words.seen & kLinearAxes
+			                                 : kLinearAxes,
+			    io_state);
+
+		// Parking, probing, leveling, machine coordinates, other coordinate
+		// systems and offsets
+		case 120:
+		case 270:
+		case 290:
+		case 300:
+		case 340:
+		case 382:
+		case 383:
+		case 384:
+		case 385:
+		case 530:
+		case 540:
+		case 550:
+		case 560:
+		case 570:
+		case 580:
+		case 590:
+		case 591:
+		case 592:
+		case 593:
+		case 921:
+		case 4250:
+			return Forget (kLinearAxes, io_state);
+
+		default:
+			return 0;
+		}
+	}
+
+
+	uint8_t ApplyM (int32_t i_code, MarlinMotionState& io_state) noexcept
+	{
+		switch (i_code)
+		{
+		case 82:
+			io_state.relative_e = false;
+			return 0;
+
+		case 83:
+			io_state.relative_e = true;
+			return 0;
+
+		// Home offsets shift the work coordinates
+		case 206:
+		case 428:
+			return Forget (kLinearAxes, io_state);
+
+		default:
+			return 0;
+		}
+	}
+} // namespace
+
+
+uint8_t ApplyMarlinMotionLine (
+    etl::string_view i_line, MarlinMotionState& io_state) noexcept
+{
+	char  letter;
+	float value;
+	bool  has_value;
+
+	if (!NextWord (i_line, letter, value, has_value))
+	{
+		return 0;
+	}
+
+	// Line number of a checksummed line
+	if (('N' == letter) && !NextWord (i_line, letter, value, has_value))
+	{
+		return 0;
+	}
+
+	if (!has_value)
+	{
+		return 0;
+	}
+
+	auto const command = letter;
+	auto const tenths  = static_cast< int32_t > (lroundf (value * 10));
+
+	// Tool changes move by the offsets of the new tool
+	if ('T' == command)
+	{
+		return Forget (kLinearAxes, io_state);
+	}
+
+	if ('M' == command)
+	{
+		return ApplyM (tenths / 10, io_state);
+	}
+
+	if ('G' != command)
+	{
+		return 0;
+	}
+
+	AxisWords words;
+
+	while (NextWord (i_line, letter, value, has_value))
+	{
+		auto const axis = AxisOfLetter (letter);
+
+		if (axis < 0)
+		{
+			continue;
+		}
+
+		words.seen |= 1 << axis;
+
+		if (has_value)
+		{
+			words.value[ axis ] = value;
+			words.with_value |= 1 << axis;
+		}
+	}
+
+	return ApplyG (tenths, words, io_state);
+}
@@ -0,0 +1,52 @@
+#ifndef SRC_DEVICES_MARLINMOTION_HPP
+#define SRC_DEVICES_MARLINMOTION_HPP
+
+
+#include <cstdint>
+
+#include <etl/string_view.h>
+
+
+/// Axes of MarlinMotionState::position
+enum MarlinAxis : uint8_t {
+	kMarlinAxisX,
+	kMarlinAxisY,
+	kMarlinAxisZ,
+	kMarlinAxisE,
+	kMarlinAxisCount,
+};
+
+
+uint8_t constexpr kMarlinAllAxes = (1 << kMarlinAxisCount) - 1;
+
+
+/**
+ * Where the printer is once the lines it acknowledged are done, as M114
+ * reports it: millimetres in the current work coordinates. Positions are
+ * meaningful only when their axis bit is set in known.
+ */
+struct MarlinMotionState {
+	float position[ kMarlinAxisCount ]{};
+
+	uint8_t known{0};          ///< Bit n for position[ n ]
+	bool    relative{false};   ///< G91, G90 otherwise
+	bool    relative_e{false}; ///< M83, M82 otherwise; G90 and G91 set it too
+	bool    inches{false};     ///< G20, G21 otherwise
+};
+
+
+/**
+ * Applies a line the printer acknowledged: the end points of G0 to G3 and
+ * G5 moves in absolute or relative mode, G92, G90, G91, M82, M83, G20 and
+ * G21. Homing, probing, coordinate system and tool changes make the axes
+ * they move unknown, M114 tells where they went.
+ *
+ * Like Marlin, only the first command of the line is taken.
+ *
+ * @return bits of the axes whose position changed or became unknown
+ */
+uint8_t ApplyMarlinMotionLine (
+    etl::string_view i_line, MarlinMotionState& io_state) noexcept;
+
+
+#endif // SRC_DEVICES_MARLINMOTION_HPP
@@ -0,0 +1,287 @@
+#include "MarlinResponse.hpp"
+
+
+#include <math.h>
+
+
+namespace {
+	void SkipSpaces (etl::string_view& io_view) noexcept
+	{
+		while (!io_view.empty () && (' ' == io_view[ 0 ]))
+		{
+			io_view.remove_prefix (1);
+		}
+	}
+
+
+	/// Takes a decimal number from the front of the view
+	bool ConsumeNumber (etl::string_view& io_view, float& o_value) noexcept
+	{
+		size_t position = 0;
+
+		auto const negative = !io_view.empty () && ('-' == io_view[ 0 ]);
+
+		if (negative || (!io_view.empty () && ('+' == io_view[ 0 ])))
+		{
+			++position;
+		}
+
+		auto value    = 0.0f;
+		auto scale    = 1.0f;
+		auto digits   = 0;
+		auto fraction = false;
+
+		for (; position < io_view.size (); ++position)
+		{
+			auto const c = io_view[ position ];
+
+			if (c >= '0' && c <= '9')
+			{
+				if (fraction)
+				{
+					scale *= 0.1f;
+					value += (c - '0') * scale;
+				}
+				else
+				{
+					value = value * 10.0f + (c - '0');
+				}
+
+				++digits;
+			}
+			else if ('.' == c && !fraction)
+			{
+				fraction = true;
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		if (0 == digits)
+		{
+			return false;
+		}
+
+		o_value = negative ? -value : value;
+
+		io_view.remove_prefix (position);
+
+		return true;
+	}
+
+
+	/// Tool number of a "Tn" key, -1 for other keys
+	int ToolNumber (etl::string_view i_key) noexcept
+	{
+		if ((i_key.size () < 2) || ('T' != i_key[ 0 ]))
+		{
+			return -1;
+		}
+
+		auto number = 0;
+
+		for (size_t i = 1; i < i_key.size (); ++i)
+		{
+			if ((i_key[ i ] < '0') || (i_key[ i ] > '9') || (number > 99))
+			{
+				return -1;
+			}
+
+			number = number * 10 + (i_key[ i ] - '0');
+		}
+
+		return number;
+	}
+
+
+	void StoreTemperature (
+	    MarlinTemperature& o_temperature,
+	    float              i_actual,
+	    bool               i_has_target,
+	    float              i_target) noexcept
+	{
+		o_temperature.actual = i_actual;
+		o_temperature.target = i_has_target ? i_target : 0.0f;
+	}
+} // namespace
+
+
+uint16_t TokenizeMarlinResponse (
+    etl::string_view i_line, MarlinResponse& o_response) noexcept
+{
+	o_response = MarlinResponse{};
+
+	auto after_count = false; ///< Axis values are steps from here on
+
+	for (;;)
+	{
+		SkipSpaces (i_line);
+
+		if (i_line.empty ())
+		{
+			break;
+		}
+
+		size_t key_length = 0;
+
+		while ((key_length < i_line.size ()) &&
+		       (' ' != i_line[ key_length ]) && (':' != i_line[ key_length ]))
+		{
+			++key_length;
+		}
+
+		auto const key = i_line.substr (0, key_length);
+
+		i_line.remove_prefix (key_length);
+
+		// A word, not a pair
+		if (i_line.empty () || (' ' == i_line[ 0 ]))
+		{
+			after_count = after_count || ("Count" == key);
+
+			continue;
+		}
+
+		i_line.remove_prefix (1);
+
+		float value;
+
+		// Not a number, the rest of it is skipped as a word
+		if (key.empty () || !ConsumeNumber (i_line, value))
+		{
+			continue;
+		}
+
+		// Temperatures may be followed by " /target"
+		auto target     = 0.0f;
+		auto has_target = false;
+
+		auto rest = i_line;
+
+		SkipSpaces (rest);
+
+		if (rest.starts_with ('/'))
+		{
+			rest.remove_prefix (1);
+
+			if (ConsumeNumber (rest, target))
+			{
+				has_target = true;
+				i_line     = rest;
+			}
+		}
+
+		// Steps of other axes, "Count A:0 B:0 Z:0" on CoreXY
+		if (after_count && (1 == key.size ()) && ('X' > key[ 0 ]))
+		{
+			continue;
+		}
+
+		if (1 == key.size ())
+		{
+			switch (key[ 0 ])
+			{
+			case 'T':
+				StoreTemperature (o_response.tool, value, has_target, target);
+				o_response.fields |= kMarlinTool;
+				o_response.fields |= has_target ? kMarlinToolTarget : 0;
+				break;
+
+			case 'B':
+				StoreTemperature (o_response.bed, value, has_target, target);
+				o_response.fields |= kMarlinBed;
+				o_response.fields |= has_target ? kMarlinBedTarget : 0;
+				break;
+
+			case '@':
+				o_response.power = value;
+				o_response.fields |= kMarlinPower;
+				break;
+
+			case 'X':
+			case 'Y':
+			case 'Z': {
+				auto const axis = key[ 0 ] - 'X';
+
+				if (after_count)
+				{
+					o_response.count[ axis ] = lroundf (value);
+					o_response.fields |= kMarlinCount;
+				}
+				else
+				{
+					o_response.position[ axis ] = value;
+					o_response.fields |= kMarlinX << axis;
+				}
+			}
+			break;
+
+			case 'E':
+				o_response.position[ 3 ] = value;
+				o_response.fields |= kMarlinE;
+				break;
+
+			default:
+				break;
+			}
+		}
+		else if (auto const tool = ToolNumber (key);
+		         !after_count && (tool >= 0) &&
+		         (tool < static_cast< int > (MarlinResponse::kMaxTools)))
+		{
+			StoreTemperature (
+			    o_response.tools[ tool ], value, has_target, target);
+			o_response.tools_found |= 1 << tool;
+			o_response.tools_targets |= has_target ? 1 << tool : 0;
+			o_response.fields |= kMarlinTools;
+		}
+	}
+
+	return o_response.fields;
+}
+
+
+etl::string_view FindMarlinM115Field (
+    etl::string_view i_reply, etl::string_view i_key) noexcept
+{
+	size_t start = 0;
+
+	// The key must be followed by ':' and start a word
+	for (;;)
+	{
+		start = i_reply.find (i_key, start);
+
+		if (etl::string_view::npos == start)
+		{
+			return {};
+		}
+
+		auto const end = start + i_key.size ();
+
+		if ((end < i_reply.size ()) && (':' == i_reply[ end ]) &&
+		    ((0 == start) || (' ' == i_reply[ start - 1 ])))
+		{
+			start = end + 1;
+
+			break;
+		}
+
+		start = end;
+	}
+
+	auto value = i_reply.substr (start);
+
+	auto const next_key = value.find (':');
+
+	if (etl::string_view::npos == next_key)
+	{
+		return value;
+	}
+
+	// Back to the space before the next key
+	auto end = value.rfind (' ', next_key);
+
+	return value.substr (0, etl::string_view::npos == end ? 0 : end);
+}
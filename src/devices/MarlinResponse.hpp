@@ -0,0 +1,73 @@
+#ifndef SRC_DEVICES_MARLINRESPONSE_HPP
+#define SRC_DEVICES_MARLINRESPONSE_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <etl/string_view.h>
+
+
+/// Values found in a response
+enum MarlinField : uint16_t {
+	kMarlinTool       = 1 << 0, ///< T:
+	kMarlinTools      = 1 << 1, ///< Some Tn:, see MarlinResponse::tools_found
+	kMarlinBed        = 1 << 2, ///< B:
+	kMarlinPower      = 1 << 3, ///< @:
+	kMarlinX          = 1 << 4,
+	kMarlinY          = 1 << 5,
+	kMarlinZ          = 1 << 6,
+	kMarlinE          = 1 << 7,
+	kMarlinCount      = 1 << 8, ///< Count X: Y: Z:
+	kMarlinToolTarget = 1 << 9, ///< T: had a /target
+	kMarlinBedTarget  = 1 << 10,
+};
+
+
+struct MarlinTemperature {
+	float actual{0};
+	float target{0};
+};
+
+
+/**
+ * Key and value pairs of a Marlin response line, such as
+ * "ok T:32.8 /0.0 B:31.8 /0.0 T0:32.8 /0.0 @:0 B@:0" or
+ * "X:-33.00 Y:-10.00 Z:5.00 E:37.95 Count X:-3300 Y:-1000 Z:2000".
+ */
+struct MarlinResponse {
+	static size_t constexpr kMaxTools = 8;
+
+	MarlinTemperature tool; ///< T:, the active tool
+	MarlinTemperature tools[ kMaxTools ];
+	MarlinTemperature bed;
+
+	float   power{0};        ///< @:, heater PWM of the active tool
+	float   position[ 4 ]{}; ///< X, Y, Z, E, before Count
+	int32_t count[ 3 ]{};    ///< X, Y, Z steps after Count
+
+	uint8_t  tools_found{0};   ///< Bit n for Tn:
+	uint8_t  tools_targets{0}; ///< Bit n if Tn: had a /target
+	uint16_t fields{0};        ///< MarlinField bits
+};
+
+
+/**
+ * Reads the pairs of the line in a single pass without allocating. Other
+ * keys and words are skipped.
+ *
+ * @return MarlinField bits of the values found, also in o_response.fields
+ */
+uint16_t TokenizeMarlinResponse (
+    etl::string_view i_line, MarlinResponse& o_response) noexcept;
+
+
+/**
+ * Value of a "KEY:value" field of an M115 reply, running up to the word
+ * before the next key. Empty if the key is not there.
+ */
+etl::string_view FindMarlinM115Field (
+    etl::string_view i_reply, etl::string_view i_key) noexcept;
+
+
+#endif // SRC_DEVICES_MARLINRESPONSE_HPP
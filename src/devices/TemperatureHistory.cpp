@@ -0,0 +1,99 @@
+#include "TemperatureHistory.hpp"
+
+
+#include <math.h>
+
+#include <etl/algorithm.h>
+
+
+TemperatureSample TemperatureSample::FromCelsius (
+    float i_actual, float i_target) noexcept
+{
+	auto const tenths = [] (float i_celsius) {
+		return static_cast< int16_t > (etl::clamp (
+		    lroundf (i_celsius * 10), kMissing + 1L, long{INT16_MAX}));
+	};
+
+	return TemperatureSample{tenths (i_actual), tenths (i_target)};
+}
+
+
+void TemperatureHistory::Add (TemperatureSample i_sample) noexcept
+{
+	auto const count = fine_count_.load ();
+
+	fine_[ count % kFineCount ].store (Pack (i_sample));
+	fine_count_.store (count + 1);
+
+	if (!i_sample.IsMissing ())
+	{
+		actual_sum_ += i_sample.actual;
+		target_sum_ += i_sample.target;
+		++summed_;
+	}
+
+	if (0 != (count + 1) % kCoarseFactor)
+	{
+		return;
+	}
+
+	TemperatureSample average;
+
+	if (0 != summed_)
+	{
+		average.actual = static_cast< int16_t > (actual_sum_ / summed_);
+		average.target = static_cast< int16_t > (target_sum_ / summed_);
+	}
+
+	auto const coarse_count = coarse_count_.load ();
+
+	coarse_[ coarse_count % kCoarseCount ].store (Pack (average));
+	coarse_count_.store (coarse_count + 1);
+
+	actual_sum_ = 0;
+	target_sum_ = 0;
+	summed_     = 0;
+}
+
+
+size_t TemperatureHistory::Size (Tier i_tier) const noexcept
+{
+	auto const capacity = Tier::kFine == i_tier ? kFineCount : kCoarseCount;
+
+	return etl::min (size_t{Count (i_tier)}, capacity);
+}
+
+
+TemperatureSample TemperatureHistory::Get (
+    Tier i_tier, size_t i_age) const noexcept
+{
+	auto const count    = Count (i_tier);
+	auto const capacity = Tier::kFine == i_tier ? kFineCount : kCoarseCount;
+
+	if (i_age >= etl::min (size_t{count}, capacity))
+	{
+		return TemperatureSample{};
+	}
+
+	auto const index = count - 1 - i_age;
+
+	return Unpack (
+	    Tier::kFine == i_tier ? fine_[ index % kFineCount ].load ()
+	                          : coarse_[ index % kCoarseCount ].load ());
+}
+
+
+uint32_t TemperatureHistory::Pack (TemperatureSample i_sample) noexcept
+{
+	return static_cast< uint16_t > (i_sample.actual) |
+	    static_cast< uint32_t > (static_cast< uint16_t > (i_sample.target))
+	    << 16;
+}
+
+
+TemperatureSample TemperatureHistory::Unpack (uint32_t i_word) noexcept
+{
+	return TemperatureSample{
+	    static_cast< int16_t > (i_word & 0xffff),
+	    static_cast< int16_t > (i_word >> 16)};
+}
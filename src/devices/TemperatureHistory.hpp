@@ -0,0 +1,99 @@
+#ifndef SRC_DEVICES_TEMPERATUREHISTORY_HPP
+#define SRC_DEVICES_TEMPERATUREHISTORY_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <etl/atomic.h>
+
+
+/// A heater reading in 0.1 °C steps
+struct TemperatureSample {
+	static int16_t constexpr kMissing = INT16_MIN;
+
+	int16_t actual{kMissing}; ///< kMissing if no reading came in time
+	int16_t target{0};
+
+	static TemperatureSample FromCelsius (
+	    float i_actual, float i_target) noexcept;
+
+	bool IsMissing () const noexcept
+	{
+		return kMissing == actual;
+	}
+
+	float Actual () const noexcept
+	{
+		return actual * 0.1f;
+	}
+
+	float Target () const noexcept
+	{
+		return target * 0.1f;
+	}
+};
+
+
+/**
+ * Readings of one heater in fixed memory: the last kFineCount samples as
+ * taken, and the averages of every kCoarseFactor of them for an hour.
+ *
+ * Added by the device task, read by any task without locking. A sample is
+ * a single word, so one replaced while it is read shows up as newer.
+ */
+class TemperatureHistory {
+public:
+	static uint32_t constexpr kSamplePeriodMs = 1000;
+
+	static size_t constexpr kFineCount    = 600; ///< 10 min at 1 s
+	static size_t constexpr kCoarseFactor = 10;
+	static size_t constexpr kCoarseCount  = 360; ///< 1 h at 10 s
+
+	enum class Tier : uint8_t {
+		kFine,
+		kCoarse,
+	};
+
+	static uint32_t constexpr PeriodMs (Tier i_tier) noexcept
+	{
+		return Tier::kFine == i_tier ? kSamplePeriodMs
+		                             : kSamplePeriodMs * kCoarseFactor;
+	}
+
+	/// Device task only, once every kSamplePeriodMs
+	void Add (TemperatureSample i_sample) noexcept;
+
+	/// Samples added to the tier since start, including those replaced since
+	uint32_t Count (Tier i_tier) const noexcept
+	{
+		return Tier::kFine == i_tier ? fine_count_.load ()
+		                             : coarse_count_.load ();
+	}
+
+	/// Samples held by the tier
+	size_t Size (Tier i_tier) const noexcept;
+
+	/// i_age 0 is the newest, up to Size () - 1
+	TemperatureSample Get (Tier i_tier, size_t i_age) const noexcept;
+
+
+private:
+	etl::atomic< uint32_t > fine_[ kFineCount ];
+	etl::atomic< uint32_t > coarse_[ kCoarseCount ];
+
+	etl::atomic< uint32_t > fine_count_{0};
+	etl::atomic< uint32_t > coarse_count_{0};
+
+	/// Of the readings since the last coarse sample, missing ones left out
+	int32_t actual_sum_{0};
+	int32_t target_sum_{0};
+	uint8_t summed_{0};
+
+	static uint32_t Pack (TemperatureSample i_sample) noexcept;
+
+	static TemperatureSample Unpack (uint32_t i_word) noexcept;
+};
+
+
+#endif // SRC_DEVICES_TEMPERATUREHISTORY_HPP
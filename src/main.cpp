@@ -6,15 +6,19 @@
 
 #include <etl/string_view.h>
 
+#include "HeightMapProbe.hpp"
 #include "InetServer.h"
 #include "Job.h"
 #include "WCharacter.h"
 #include "devices/GCodeDevice.h"
 
 #include "ui/DRO.h"
+#include "ui/ErrorLogView.hpp"
 #include "ui/FileChooser.h"
 #include "ui/GrblDRO.h"
+#include "ui/OverrideControl.hpp"
 #include "ui/SpindleControl.hpp"
+#include "ui/TemperatureGraph.hpp"
 #include "ui/ToolTable.hpp"
 
 
@@ -75,17 +79,26 @@ Job* job;
 
 DynamicJsonDocument grbl_dro_config{512};
 
+bool     marlin_line_checksums    = true;
+uint32_t marlin_progress_report_s = 30;
+
+GCodeDevice::PollRates status_poll_rates;
+
 enum class Mode { DRO, FILECHOOSER };
 
 using GrblToolTable = ToolTable< 25 >;
 
-Display        display;
-FileChooser    fileChooser;
-GrblToolTable  tool_table;
-SpindleControl spindle_control;
-uint8_t        droBuffer[ sizeof (GrblDRO) ];
-DRO*           dro;
-Mode           cMode = Mode::DRO;
+Display          display;
+FileChooser      fileChooser;
+GrblToolTable    tool_table;
+SpindleControl   spindle_control;
+OverrideControl  override_control;
+ErrorLogView     error_log_view;
+TemperatureGraph temperature_graph;
+HeightMapProbe   height_map_probe;
+uint8_t          droBuffer[ sizeof (GrblDRO) ];
+DRO*             dro;
+Mode             cMode = Mode::DRO;
 
 void encISR ();
 
@@ -202,6 +215,36 @@ void setup ()
 		grbl_dro_config.set (grbl_dro_conf_doc);
 	}
 
+	if (auto const line_checksums = cfg[ "marlin" ][ "line_checksums" ];
+	    !line_checksums.isNull ())
+	{
+		marlin_line_checksums = line_checksums.as< bool > ();
+	}
+
+	if (auto const progress_report_s = cfg[ "marlin" ][ "progress_report_s" ];
+	    progress_report_s.is< uint32_t > ())
+	{
+		marlin_progress_report_s = progress_report_s.as< uint32_t > ();
+	}
+
+	if (auto const idle_ms = cfg[ "status_polling" ][ "idle_ms" ];
+	    idle_ms.is< uint16_t > ())
+	{
+		status_poll_rates.idle = idle_ms.as< uint16_t > ();
+	}
+
+	if (auto const active_ms = cfg[ "status_polling" ][ "active_ms" ];
+	    active_ms.is< uint16_t > ())
+	{
+		status_poll_rates.active = active_ms.as< uint16_t > ();
+	}
+
+	if (auto const alarm_ms = cfg[ "status_polling" ][ "alarm_ms" ];
+	    alarm_ms.is< uint16_t > ())
+	{
+		status_poll_rates.alarm = alarm_ms.as< uint16_t > ();
+	}
+
 	xTaskCreatePinnedToCore (
 	    deviceLoop,
 	    "DeviceTask",
@@ -225,6 +268,8 @@ void setup ()
 
 	// dro.config(cfg["menu"].as<JsonObjectConst>() );
 
+	height_map_probe.ApplyConfig (cfg[ "probe" ].as< JsonObjectConst > ());
+
 	tool_table.ApplyConfig (
 	    cfg[ "tool_compensation" ].as< JsonObjectConst > ());
 	tool_table.SetReturnCallback (
@@ -235,6 +280,15 @@ void setup ()
 	spindle_control.SetReturnCallback (
 	    [ &dro ] () { Display::getDisplay ()->setScreen (dro); });
 
+	override_control.SetReturnCallback (
+	    [ &dro ] () { Display::getDisplay ()->setScreen (dro); });
+
+	error_log_view.SetReturnCallback (
+	    [ &dro ] () { Display::getDisplay ()->setScreen (dro); });
+
+	temperature_graph.SetReturnCallback (
+	    [ &dro ] () { Display::getDisplay ()->setScreen (dro); });
+
 	fileChooser.begin ();
 	fileChooser.setCallback ([ & ] (bool res, const String& path) {
 		if (res)
@@ -281,7 +335,18 @@ void deviceLoop (void* pvParams)
 	// dev->add_observer(fileChooser);
 	dev->addReceivedLineHandler (
 	    [] (const char* d, size_t l) { server.resendDeviceResponse (d, l); });
+	dev->attachTask (xTaskGetCurrentTaskHandle ());
+	PrinterSerial.onReceive (
+	    [] () { dev->notifyEvent (GCodeDevice::EVENT_RX); });
+	if (dev->getType () == "marlin")
+	{
+		static_cast< MarlinDevice* > (dev)->setLineChecksums (
+		    marlin_line_checksums);
+		job->setProgressReportInterval (marlin_progress_report_s * 1000);
+	}
+	dev->setPollRates (status_poll_rates);
 	dev->begin ();
+	dev->enableStatusUpdates ();
 
 	if (dev->getType () == "grbl")
 	{
@@ -294,6 +359,8 @@ void deviceLoop (void* pvParams)
 		dro = grbl_dro;
 
 		dev->add_observer (spindle_control);
+
+		dev->add_observer (override_control);
 	}
 	else
 		dro = new (droBuffer) DRO ();
@@ -305,6 +372,7 @@ void deviceLoop (void* pvParams)
 	while (1)
 	{
 		dev->loop ();
+		dev->waitForEvent ();
 	}
 	vTaskDelete (NULL);
 }
@@ -362,6 +430,8 @@ void loop ()
 
 	job->loop ();
 
+	height_map_probe.Loop ();
+
 	display.loop ();
 
 	if (dev == nullptr)
@@ -2,6 +2,7 @@
 
 
 #include "../devices/GCodeDevice.h"
+#include "TemperatureGraph.hpp"
 
 #include "../discrete_switch_potentiometer.hpp"
 #include "../potentiometers_config.hpp"
@@ -12,30 +13,21 @@ DRO::DRO ()
 }
 
 
-void DRO::begin ()
-{
-	nextRefresh = millis () + kPeriod;
-}
+extern TemperatureGraph temperature_graph;
 
 
-void DRO::loop ()
+void DRO::begin ()
 {
-	Screen::loop ();
+	Screen::begin ();
 
-	auto const current_time = millis ();
+	// Only Marlin has heaters to watch
+	GCodeDevice* dev = GCodeDevice::getDevice ();
 
-	if (refresh_enabled_ && (current_time > nextRefresh))
+	if (dev != nullptr && dev->getType () == "marlin")
 	{
-		nextRefresh = current_time + kPeriod;
-
-		GCodeDevice* dev = GCodeDevice::getDevice ();
-
-		if (dev != nullptr)
-		{
-			dev->requestStatusUpdate ();
-		}
-
-		setDirty ();
+		menuItems.push_back (MenuItem::simpleItem (0, 'C', [] (MenuItem&) {
+			Display::getDisplay ()->setScreen (&temperature_graph);
+		}));
 	}
 }
 
@@ -43,7 +35,14 @@ void DRO::loop ()
 void DRO::enableRefresh (bool r)
 {
 	refresh_enabled_ = r;
-	nextRefresh      = millis () + kPeriod;
+
+	// Status polling is scheduled by the device at the machine activity rate
+	GCodeDevice* dev = GCodeDevice::getDevice ();
+
+	if (dev != nullptr)
+	{
+		dev->enableStatusUpdates (r);
+	}
 }
 
 
@@ -139,7 +138,7 @@ void DRO::onButtonPressed (Button bt, int8_t arg)
 
 		if (lastJogTime != 0)
 		{
-			f = d / (millis () - lastJogTime) * 1000 * 60;
+			f = fabsf (d) / (millis () - lastJogTime) * 1000 * 60;
 		};
 
 		if (f < 500)
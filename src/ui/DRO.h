@@ -15,20 +15,14 @@ public:
 
 	void begin () override;
 
-	void loop () override;
-
 	void enableRefresh (bool r);
 
 	bool isRefreshEnabled ();
 
 
 protected:
-	static auto constexpr kPeriod = 500;
-
-
 	JogAxis  cAxis;
 	JogDist  cDist;
-	uint32_t nextRefresh{};
 	uint32_t lastJogTime{};
 
 	bool refresh_enabled_{true};
@@ -0,0 +1,227 @@
+#include "ErrorLogView.hpp"
+
+
+#include <stdio.h>
+
+#include <etl/algorithm.h>
+
+#include "../Job.h"
+#include "../devices/GrblDevice.hpp"
+
+#include "../font_info.hpp"
+
+
+void ErrorLogView::SetReturnCallback (
+    std::function< void () > i_return_callback)
+{
+	assert (bool (i_return_callback));
+
+	return_callback_ = etl::move (i_return_callback);
+}
+
+
+void ErrorLogView::loop ()
+{
+	Refresh ();
+}
+
+
+void ErrorLogView::onShow ()
+{
+	selected_record_    = 0;
+	first_shown_record_ = 0;
+	shown_log_count_    = 0;
+	record_count_       = 0;
+
+	Refresh ();
+}
+
+
+void ErrorLogView::Refresh ()
+{
+	auto const device = static_cast< GrblDevice* > (GCodeDevice::getDevice ());
+
+	if (nullptr == device)
+	{
+		return;
+	}
+
+	auto const& log = device->ErrorLog ();
+
+	if (auto const count = log.Count (); count != shown_log_count_)
+	{
+		shown_log_count_ = count;
+		record_count_    = log.Snapshot (records_);
+
+		if (selected_record_ >= static_cast< int > (record_count_))
+		{
+			selected_record_    = 0;
+			first_shown_record_ = 0;
+		}
+
+		setDirty ();
+	}
+}
+
+
+void ErrorLogView::drawContents ()
+{
+	static constexpr auto& kFont = u8g2_font_4x6_tr;
+
+	static auto const kLineHeight = ComputeLineHeight (kFont, Display::u8g2);
+	static auto const kRecordHeight = 2 * kLineHeight + 1;
+
+	static auto constexpr kTopY = Display::STATUS_BAR_HEIGHT + 1;
+
+	// The detail line and the menu stay free
+	static auto const kDetailY =
+	    Display::u8g2.getHeight () - 10 - kLineHeight - 1;
+
+	visible_records_ = etl::max (1, (kDetailY - kTopY) / kRecordHeight);
+
+
+	U8G2& u8g2 = Display::u8g2;
+
+	u8g2.setFont (kFont);
+	u8g2.setDrawColor (1);
+
+	char str[ 24 ]{};
+
+	snprintf (str, sizeof (str), "Errors: %u", shown_log_count_);
+	u8g2.drawStr (12, 0, str);
+
+	if (0 == record_count_)
+	{
+		u8g2.drawStr (0, kTopY, "None");
+
+		return;
+	}
+
+	for (int i = 0; (i < visible_records_) &&
+	     (first_shown_record_ + i < static_cast< int > (record_count_));
+	     ++i)
+	{
+		auto const  index  = first_shown_record_ + i;
+		auto const& record = records_[ record_count_ - 1 - index ];
+		auto const  line_y = kTopY + i * kRecordHeight;
+
+		u8g2.setDrawColor (1);
+
+		if (index == selected_record_)
+		{
+			u8g2.drawBox (0, line_y, u8g2.getWidth (), kRecordHeight);
+		}
+
+		u8g2.setDrawColor (2);
+
+		if (!record.has_line)
+		{
+			snprintf (
+			    str,
+			    sizeof (str),
+			    "%c%u",
+			    record.alarm ? 'A' : 'E',
+			    record.code);
+		}
+		else if (0 != record.line_number)
+		{
+			snprintf (
+			    str,
+			    sizeof (str),
+			    "%c%u L%u",
+			    record.alarm ? 'A' : 'E',
+			    record.code,
+			    record.line_number);
+		}
+		else
+		{
+			snprintf (
+			    str,
+			    sizeof (str),
+			    "%c%u %s",
+			    record.alarm ? 'A' : 'E',
+			    record.code,
+			    GCodeDevice::getLaneName (
+			        static_cast< GCodeDevice::Lane > (record.lane)));
+		}
+
+		u8g2.drawStr (1, line_y + 1, str);
+		u8g2.drawStr (1, line_y + 1 + kLineHeight, record.Message ());
+	}
+
+	u8g2.setDrawColor (1);
+
+	// Where exactly the selected one came from
+	auto const& selected = records_[ record_count_ - 1 - selected_record_ ];
+
+	if (selected.has_line)
+	{
+		snprintf (
+		    str,
+		    sizeof (str),
+		    "@%u #%04x",
+		    selected.file_offset,
+		    selected.line_hash);
+
+		u8g2.drawStr (0, kDetailY, str);
+	}
+}
+
+
+void ErrorLogView::onButtonPressed (Button i_button, int8_t i_arg)
+{
+	switch (i_button)
+	{
+	default: {
+	}
+	break;
+
+	case Button::BT1: {
+		return_callback_ ();
+	}
+	break;
+
+	case Button::BT2: {
+		if (0 == record_count_)
+		{
+			return;
+		}
+
+		auto const& record = records_[ record_count_ - 1 - selected_record_ ];
+
+		if (!record.has_line || (0 == record.line_number))
+		{
+			return;
+		}
+
+		if (Job::getJob ()->resumeFrom (record.line_number))
+		{
+			return_callback_ ();
+		}
+	}
+	break;
+
+	case Button::ENC_DOWN:
+		[[fallthrough]];
+	case Button::ENC_UP: {
+		if (0 == record_count_)
+		{
+			return;
+		}
+
+		selected_record_ = etl::clamp (
+		    selected_record_ - i_arg,
+		    0,
+		    static_cast< int > (record_count_) - 1);
+
+		// Keep the selection in view
+		first_shown_record_ = etl::clamp (
+		    first_shown_record_,
+		    selected_record_ - visible_records_ + 1,
+		    selected_record_);
+
+		setDirty ();
+	}
+	break;
+	}
+}
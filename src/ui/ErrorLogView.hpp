@@ -0,0 +1,52 @@
+#ifndef SRC_UI_ERRORLOGVIEW_HPP
+#define SRC_UI_ERRORLOGVIEW_HPP
+
+
+#include <functional>
+
+#include <Arduino.h>
+
+
+#include "../devices/GrblErrors.hpp"
+#include "Screen.h"
+
+
+/*
+  Errors and alarms of a Grbl machine, newest first, with the job line each
+  one came from. The encoder scrolls, BT1 returns, BT2 resumes the stopped
+  job at the line of the selected one.
+*/
+class ErrorLogView : public Screen {
+public:
+	void SetReturnCallback (std::function< void () > i_return_callback);
+
+	void loop () override;
+
+
+protected:
+	void drawContents () override;
+
+	void onButtonPressed (Button i_button, int8_t i_arg) override;
+
+	void onShow () override;
+
+
+private:
+	GrblErrorRecord records_[ GrblErrorLog::kCapacity ];
+
+	size_t record_count_{0};
+
+	uint32_t shown_log_count_{0}; ///< GrblErrorLog::Count () of the records
+
+	int selected_record_{0}; ///< 0 is the newest
+	int first_shown_record_{0};
+	int visible_records_{1}; ///< As many as the last drawing fit
+
+	std::function< void () > return_callback_;
+
+	/// Copies the records again if the log changed
+	void Refresh ();
+};
+
+
+#endif // SRC_UI_ERRORLOGVIEW_HPP
@@ -6,6 +6,8 @@
 
 #include "../Job.h"
 #include "FileChooser.h"
+#include "ui/ErrorLogView.hpp"
+#include "ui/OverrideControl.hpp"
 #include "ui/SpindleControl.hpp"
 #include "ui/ToolTable.hpp"
 
@@ -19,6 +21,8 @@
 extern FileChooser     fileChooser;
 extern ToolTable< 25 > tool_table;
 extern SpindleControl  spindle_control;
+extern OverrideControl override_control;
+extern ErrorLogView    error_log_view;
 
 
 namespace {
@@ -117,7 +121,7 @@ void GrblDRO::begin ()
 
 	DRO::begin ();
 
-	static etl::flat_map< char, AddMenuItemFunction, kMenuItemCountMax > const
+	static etl::flat_map< char, AddMenuItemFunction, kMenuItemKindCount > const
 	    menu_item_factory = {
 	        {'T',
 	         [] (char i_glyph, GrblDRO& io_dro, int16_t& io_id) {
@@ -188,7 +192,7 @@ void GrblDRO::begin ()
 		             io_id++, i_glyph, [ &dro = io_dro ] (MenuItem&) {
 			             GCodeDevice::getDevice ()->scheduleCommand (
 			                 dro.wco_offset_cmd_);
-			             GCodeDevice::getDevice ()->scheduleCommand ("G54");
+			             GCodeDevice::getDevice ()->scheduleModeCommand ("G54");
 
 			             dro.device_coordinates_changed_ = true;
 		             });
@@ -208,7 +212,8 @@ void GrblDRO::begin ()
 			             GCodeDevice::getDevice ()->scheduleCommand ("M5");
 		             }};
 	         }},
-	        {'S', [] (char i_glyph, GrblDRO& io_dro, int16_t& io_id) {
+	        {'S',
+	         [] (char i_glyph, GrblDRO& io_dro, int16_t& io_id) {
 		         return MenuItem::simpleItem (io_id++, i_glyph, [] (MenuItem&) {
 			         Job* job = Job::getJob ();
 
@@ -219,6 +224,17 @@ void GrblDRO::begin ()
 
 			         Display::getDisplay ()->setScreen (&spindle_control);
 		         });
+	         }},
+	        {'O',
+	         [] (char i_glyph, GrblDRO& io_dro, int16_t& io_id) {
+		         return MenuItem::simpleItem (io_id++, i_glyph, [] (MenuItem&) {
+			         Display::getDisplay ()->setScreen (&override_control);
+		         });
+	         }},
+	        {'E', [] (char i_glyph, GrblDRO& io_dro, int16_t& io_id) {
+		         return MenuItem::simpleItem (io_id++, i_glyph, [] (MenuItem&) {
+			         Display::getDisplay ()->setScreen (&error_log_view);
+		         });
 	         }}};
 
 	auto id = int16_t{};
@@ -232,6 +248,20 @@ void GrblDRO::begin ()
 };
 
 
+void GrblDRO::loop ()
+{
+	auto const now = millis ();
+
+	if (position_estimator_.IsMoving (now) &&
+	    (static_cast< int32_t > (now - next_frame_time_) >= 0))
+	{
+		next_frame_time_ = now + kFrameMs;
+
+		setDirty ();
+	}
+}
+
+
 void GrblDRO::notification (const DeviceStatusEvent& i_event)
 {
 	GrblDevice* dev = static_cast< GrblDevice* > (GCodeDevice::getDevice ());
@@ -243,6 +273,17 @@ void GrblDRO::notification (const DeviceStatusEvent& i_event)
 
 	auto const can_jog = dev->canJog ();
 
+	// A cancelled or clamped jog stops short of the target, take the
+	// position the machine stopped at
+	if (((dev->JogCancelCount () != seen_jog_cancels_) ||
+	     (dev->JogClampCount () != seen_jog_clamps_)) &&
+	    (GrblState::kIdle == dev->Status ().state))
+	{
+		seen_jog_cancels_           = dev->JogCancelCount ();
+		seen_jog_clamps_            = dev->JogClampCount ();
+		device_coordinates_changed_ = true;
+	}
+
 	if (device_coordinates_changed_ || (can_jog != last_can_jog_state_))
 	{
 		last_can_jog_state_ = can_jog;
@@ -261,10 +302,54 @@ void GrblDRO::notification (const DeviceStatusEvent& i_event)
 		}
 	}
 
+	if (auto const report_time = dev->StatusReportTime ();
+	    report_time != seen_status_report_time_)
+	{
+		seen_status_report_time_ = report_time;
+
+		UpdateEstimator (*dev, report_time);
+	}
+
 	setDirty ();
 }
 
 
+void GrblDRO::UpdateEstimator (
+    const GrblDevice& i_device, uint32_t i_report_time)
+{
+	auto const& status = i_device.Status ();
+
+	auto feed = (status.fields & kFieldFeed) ? status.feed : -1.0f;
+
+	switch (status.state)
+	{
+	case GrblState::kJog: {
+		position_estimator_.SetTarget (target_mach_position_);
+	}
+	break;
+
+	case GrblState::kRun:
+		[[fallthrough]];
+	case GrblState::kHold:
+		[[fallthrough]];
+	case GrblState::kHome: {
+		// The end of a program move is not known here
+		position_estimator_.ClearTarget ();
+	}
+	break;
+
+	default: {
+		position_estimator_.ClearTarget ();
+
+		feed = 0.0f;
+	}
+	break;
+	}
+
+	position_estimator_.Report (status.machine_position, feed, i_report_time);
+}
+
+
 void GrblDRO::drawContents ()
 {
 	static constexpr auto& kDroFont    = u8g2_font_7x13B_tr;
@@ -305,15 +390,20 @@ void GrblDRO::drawContents ()
 
 	auto const can_jog = dev->canJog ();
 
-	auto const work_coordinates = can_jog
-	    ? target_work_position_
-	    : Vector3f{dev->getX (), dev->getY (), dev->getZ ()};
+	/*
+	  While jogging the work position shows the commanded target, the
+	  machine position where the machine is estimated to be by now.
+	*/
+	auto const mach_coordinates = position_estimator_.Estimate (millis ());
 
-	auto const mach_coordinates = can_jog ? target_mach_position_
+	auto const work_coordinates = can_jog ? target_work_position_
 	                                      : Vector3f{
-	                                            dev->getX () + dev->getXOfs (),
-	                                            dev->getY () + dev->getYOfs (),
-	                                            dev->getZ () + dev->getZOfs ()};
+	                                            mach_coordinates.x -
+	                                                dev->getXOfs (),
+	                                            mach_coordinates.y -
+	                                                dev->getYOfs (),
+	                                            mach_coordinates.z -
+	                                                dev->getZOfs ()};
 
 	U8G2& u8g2 = Display::u8g2;
 
@@ -346,7 +436,7 @@ void GrblDRO::drawContents ()
 		}
 	}
 
-	auto const& input_pin_state = dev->InputPinState ();
+	auto const input_pins = dev->InputPins ();
 
 	{ // Draw machine coordinates
 		u8g2.setFont (kMachFont);
@@ -367,7 +457,7 @@ void GrblDRO::drawContents ()
 
 			DrawMachAxis (mach_coordinates[ item ], line_y);
 
-			if (-1 < input_pin_state.indexOf (item))
+			if (input_pins & GrblPinFromLetter (item))
 			{
 				Display::u8g2.drawStr (
 				    u8g2.getWidth () - u8g2.getStrWidth ("!"), line_y, "!");
@@ -397,7 +487,7 @@ void GrblDRO::drawContents ()
 
 		u8g2.drawStr (tool_info_x, 0, tool_info);
 
-		if (-1 < input_pin_state.indexOf ("P"))
+		if (input_pins & kPinProbe)
 		{
 			u8g2.drawStr (probe_state_x, 0, "P");
 		}
@@ -435,9 +525,39 @@ void GrblDRO::drawContents ()
 	}
 
 	const char* stat = dev->isInPanic () ? dev->getLastResponse ().c_str ()
-	                                     : dev->getStatus ().c_str ();
+	                                     : dev->getStatus ();
 
 	u8g2.drawStr (0, kStatusLineY, stat);
+
+	// Work coordinate system, units and distance mode
+	static auto constexpr kShownModes =
+	    kModalCoordinateSystem | kModalUnits | kModalDistance;
+
+	if (auto const& modes = dev->ModalState ();
+	    kShownModes == (modes.known & kShownModes))
+	{
+		char modes_str[ sizeof ("G54 mm inc") ];
+
+		snprintf (
+		    modes_str,
+		    sizeof (modes_str),
+		    "G%d %s%s",
+		    54 + modes.coordinate_system,
+		    modes.inches ? "in" : "mm",
+		    modes.incremental ? " inc" : "");
+
+		auto const stat_width = u8g2.getStrWidth (stat);
+
+		u8g2.setFont (kOptionFont);
+
+		// Only when there is room next to an error message
+		if (auto const modes_width = u8g2.getStrWidth (modes_str);
+		    stat_width + modes_width + 2 <= u8g2.getWidth ())
+		{
+			u8g2.drawStr (
+			    u8g2.getWidth () - modes_width, kStatusLineY + 1, modes_str);
+		}
+	}
 };
 
 
@@ -459,9 +579,10 @@ void GrblDRO::onButtonPressed (Button i_button, int8_t i_arg)
 
 	if (lastJogTime != 0)
 	{
-		feed = jog_distance / (current_time - lastJogTime) * 1000 * 60;
+		feed = fabsf (jog_distance) / (current_time - lastJogTime) * 1000 * 60;
 	};
 
+	// The device limits the feed to the max rate of the axis
 	if (feed < 500)
 	{
 		feed = 500;
@@ -470,6 +591,8 @@ void GrblDRO::onButtonPressed (Button i_button, int8_t i_arg)
 	target_mach_position_[ jog_axis ] += jog_distance;
 	target_work_position_[ jog_axis ] += jog_distance;
 
+	position_estimator_.SetTarget (target_mach_position_);
+
 	lastJogTime = current_time;
 
 	if (!dev->jog (cAxis, jog_distance, static_cast< int > (feed)))
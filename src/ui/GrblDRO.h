@@ -5,16 +5,22 @@
 
 
 #include "DRO.h"
+#include "MotionEstimator.hpp"
 
 #include "../VectorND.hpp"
 
 
+class GrblDevice;
+
+
 class GrblDRO : public DRO, public DeviceObserver {
 public:
 	void ApplyConfig (JsonObjectConst i_config) noexcept;
 
 	void begin () override;
 
+	void loop () override;
+
 	void notification (const DeviceStatusEvent& i_event) override;
 
 
@@ -26,12 +32,16 @@ protected:
 
 
 private:
-	static size_t constexpr kMenuItemCountMax = 10;
-	static size_t constexpr kDroItemCountMax  = 3;
-	static size_t constexpr kJogStepCount     = 3;
+	static size_t constexpr kMenuItemCountMax  = 10;
+	static size_t constexpr kMenuItemKindCount = 11; ///< Glyphs that exist
+	static size_t constexpr kDroItemCountMax   = 3;
+	static size_t constexpr kJogStepCount      = 3;
+
+	/// Redraw period while the estimated position moves
+	static uint32_t constexpr kFrameMs = 40;
 
 	static inline etl::vector< char, kMenuItemCountMax > const
-	    kDefaultMenuItems = {'T', 'o', 'p', 'u', 'H', 'w', 'L', 'S'};
+	    kDefaultMenuItems = {'T', 'o', 'p', 'u', 'H', 'w', 'L', 'S', 'O', 'E'};
 
 	static inline etl::vector< char, kDroItemCountMax > const kDefaultDroItems =
 	    {'X', 'Y', 'Z'};
@@ -51,6 +61,17 @@ private:
 	bool last_can_jog_state_{false};
 	bool device_coordinates_changed_{false};
 
+	uint32_t seen_jog_cancels_{0};
+	uint32_t seen_jog_clamps_{0};
+
 	Vector3f target_mach_position_;
 	Vector3f target_work_position_;
+
+	/// Machine position between status reports
+	MotionEstimator position_estimator_;
+
+	uint32_t seen_status_report_time_{0};
+	uint32_t next_frame_time_{0};
+
+	void UpdateEstimator (const GrblDevice& i_device, uint32_t i_report_time);
 };
@@ -0,0 +1,122 @@
+#include "MotionEstimator.hpp"
+
+
+#include <math.h>
+
+
+namespace {
+	Vector3f Difference (const Vector3f& i_to, const Vector3f& i_from)
+	{
+		return Vector3f{
+		    i_to.x - i_from.x, i_to.y - i_from.y, i_to.z - i_from.z};
+	}
+
+
+	float Length (const Vector3f& i_vector)
+	{
+		return sqrtf (
+		    i_vector.x * i_vector.x + i_vector.y * i_vector.y +
+		    i_vector.z * i_vector.z);
+	}
+} // namespace
+
+
+void MotionEstimator::Report (
+    const Vector3f& i_position, float i_feed, uint32_t i_time) noexcept
+{
+	previous_position_ = last_position_;
+	previous_time_     = last_time_;
+	last_position_     = i_position;
+	last_time_         = i_time;
+
+	auto const had_previous = has_previous_;
+
+	has_previous_ = true;
+	speed_        = 0.0f;
+
+	if (!had_previous || (i_time == previous_time_) || (0.0f == i_feed))
+	{
+		return;
+	}
+
+	auto const delta    = Difference (last_position_, previous_position_);
+	auto const distance = Length (delta);
+
+	if (distance >= kMinDistance)
+	{
+		direction_ = Vector3f{
+		    delta.x / distance, delta.y / distance, delta.z / distance};
+	}
+	else if (!has_target_ || (i_feed < 0.0f))
+	{
+		return;
+	}
+
+	// The reported feed is the current one, the reports only give an average
+	speed_ = i_feed > 0.0f ? i_feed / 60000.0f
+	                       : distance / (i_time - previous_time_);
+}
+
+
+void MotionEstimator::SetTarget (const Vector3f& i_target) noexcept
+{
+	target_     = i_target;
+	has_target_ = true;
+}
+
+
+void MotionEstimator::ClearTarget () noexcept
+{
+	has_target_ = false;
+}
+
+
+bool MotionEstimator::IsMoving (uint32_t i_now) const noexcept
+{
+	return (speed_ > 0.0f) && (i_now - last_time_ < ExtrapolationLimit ());
+}
+
+
+Vector3f MotionEstimator::Estimate (uint32_t i_now) const noexcept
+{
+	if ((speed_ <= 0.0f) || (static_cast< int32_t > (i_now - last_time_) <= 0))
+	{
+		return last_position_;
+	}
+
+	auto const limit   = ExtrapolationLimit ();
+	auto const elapsed = i_now - last_time_;
+	auto       travel  = speed_ * (elapsed < limit ? elapsed : limit);
+	auto       heading = direction_;
+
+	if (has_target_)
+	{
+		auto const to_target = Difference (target_, last_position_);
+		auto const remaining = Length (to_target);
+
+		if (travel >= remaining)
+		{
+			return target_;
+		}
+
+		heading = Vector3f{
+		    to_target.x / remaining,
+		    to_target.y / remaining,
+		    to_target.z / remaining};
+	}
+
+	return Vector3f{
+	    last_position_.x + heading.x * travel,
+	    last_position_.y + heading.y * travel,
+	    last_position_.z + heading.z * travel};
+}
+
+
+uint32_t MotionEstimator::ExtrapolationLimit () const noexcept
+{
+	// A late report must not let the estimate run away
+	auto const interval = last_time_ - previous_time_;
+
+	return 2 * interval < kMaxExtrapolationMs ? 2 * interval
+	                                          : kMaxExtrapolationMs;
+}
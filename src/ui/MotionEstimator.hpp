@@ -0,0 +1,65 @@
+#ifndef SRC_UI_MOTIONESTIMATOR_HPP
+#define SRC_UI_MOTIONESTIMATOR_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+
+
+#include "../VectorND.hpp"
+
+
+/*
+  Estimates the machine position between two status reports, so the DRO can
+  move at the display frame rate while the device is polled slowly. The
+  position keeps going from the last report at the reported feed, along the
+  commanded target when there is one, otherwise along the line through the
+  last two reports. Every report replaces the estimate.
+*/
+class MotionEstimator {
+public:
+	/**
+	 * New report of the position. i_feed is the reported feed in units per
+	 * minute, 0 when the machine stands still and negative when the feed is
+	 * not reported, the speed then comes from the last two reports.
+	 */
+	void Report (
+	    const Vector3f& i_position, float i_feed, uint32_t i_time) noexcept;
+
+	/// End of the commanded motion, e.g. of a jog. The estimate stops there.
+	void SetTarget (const Vector3f& i_target) noexcept;
+
+	void ClearTarget () noexcept;
+
+	Vector3f Estimate (uint32_t i_now) const noexcept;
+
+	/// Whether the estimate still changes after i_now
+	bool IsMoving (uint32_t i_now) const noexcept;
+
+
+private:
+	/// Never runs ahead further than this, in case the reports stop
+	static uint32_t constexpr kMaxExtrapolationMs = 1000;
+
+	/// Shorter motions between two reports count as standing still
+	static float constexpr kMinDistance = 0.0005f;
+
+	Vector3f last_position_;
+	Vector3f previous_position_;
+	Vector3f direction_; ///< Unit vector, used without target
+	Vector3f target_;
+
+	uint32_t last_time_{0};
+	uint32_t previous_time_{0};
+
+	float speed_{0.0f}; ///< Units per millisecond
+
+	bool has_previous_{false};
+	bool has_target_{false};
+
+	/// How long after the last report the estimate keeps going
+	uint32_t ExtrapolationLimit () const noexcept;
+};
+
+
+#endif // SRC_UI_MOTIONESTIMATOR_HPP
@@ -0,0 +1,214 @@
+#include "OverrideControl.hpp"
+
+
+#include <stdio.h>
+
+#include "../devices/GrblDevice.hpp"
+
+#include "../font_info.hpp"
+
+#include "../discrete_switch_potentiometer.hpp"
+#include "../potentiometers_config.hpp"
+
+
+void OverrideControl::SetReturnCallback (
+    std::function< void () > i_return_callback)
+{
+	assert (bool (i_return_callback));
+
+	return_callback_ = etl::move (i_return_callback);
+}
+
+
+void OverrideControl::notification (const DeviceStatusEvent& i_event)
+{
+	auto const device = static_cast< GrblDevice* > (GCodeDevice::getDevice ());
+
+	if (nullptr == device)
+	{
+		return;
+	}
+
+	auto changed = false;
+
+	for (size_t i = 0; i < kGrblOverrideCount; ++i)
+	{
+		auto const kind   = static_cast< GrblOverride > (i);
+		auto const value  = device->OverrideValue (kind);
+		auto const target = device->OverrideTarget (kind);
+
+		changed |=
+		    (shown_values_[ i ] != value) || (shown_targets_[ i ] != target);
+
+		shown_values_[ i ]  = value;
+		shown_targets_[ i ] = target;
+	}
+
+	setDirty (changed);
+}
+
+
+void OverrideControl::drawContents ()
+{
+	static constexpr auto& kMainFont   = u8g2_font_7x13B_tr;
+	static constexpr auto& kTargetFont = u8g2_font_5x7_tr;
+	static constexpr auto& kStatusFont = u8g2_font_4x6_tr;
+
+	static char const* const kLabels[ kGrblOverrideCount ] = {
+	    "Feed", "Rapid", "Spndl"};
+
+	static auto const kMainLineHeight =
+	    ComputeLineHeight (kMainFont, Display::u8g2);
+	static auto const kStatusLineY = Display::u8g2.getHeight () -
+	    ComputeLineHeight (kStatusFont, Display::u8g2);
+
+	static auto constexpr kTopY = Display::STATUS_BAR_HEIGHT + 1;
+
+
+	GrblDevice* device = static_cast< GrblDevice* > (GCodeDevice::getDevice ());
+
+	if (nullptr == device)
+	{
+		return;
+	}
+
+	U8G2& u8g2 = Display::u8g2;
+
+	for (size_t i = 0; i < kGrblOverrideCount; ++i)
+	{
+		auto const kind   = static_cast< GrblOverride > (i);
+		auto const line_y = kTopY + kMainLineHeight * static_cast< int > (i);
+
+		u8g2.setDrawColor (1);
+
+		if (static_cast< int > (i) == selected_override_)
+		{
+			u8g2.drawBox (0, line_y - 1, u8g2.getWidth (), kMainLineHeight);
+		}
+
+		u8g2.setDrawColor (2);
+		u8g2.setFont (kMainFont);
+
+		char str[ 16 ]{};
+
+		snprintf (
+		    str,
+		    sizeof (str),
+		    "%-5s %3d%%",
+		    kLabels[ i ],
+		    device->OverrideValue (kind));
+
+		u8g2.drawStr (2, line_y, str);
+
+		// The requested value until the machine reports it
+		if (auto const target = device->OverrideTarget (kind); 0 != target)
+		{
+			u8g2.setFont (kTargetFont);
+
+			snprintf (str, sizeof (str), ">%3d", target);
+
+			u8g2.drawStr (
+			    u8g2.getWidth () - u8g2.getStrWidth (str) - 2,
+			    line_y + 3,
+			    str);
+		}
+	}
+
+	u8g2.setDrawColor (1);
+	u8g2.setFont (kStatusFont);
+
+	{ // Draw step and machine state
+		char str[ 16 ]{};
+
+		snprintf (
+		    str, sizeof (str), "Step %d%%", kStepValues[ selected_step_ ]);
+
+		u8g2.drawStr (0, kStatusLineY, str);
+	}
+
+	const char* stat = device->isInPanic ()
+	    ? device->getLastResponse ().c_str ()
+	    : device->getStatus ();
+
+	u8g2.drawStr (
+	    u8g2.getWidth () - u8g2.getStrWidth (stat), kStatusLineY, stat);
+};
+
+
+void OverrideControl::onButtonPressed (Button i_button, int8_t i_arg)
+{
+	if (Button::BT1 == i_button)
+	{
+		return_callback_ ();
+
+		return;
+	}
+
+	auto const device = static_cast< GrblDevice* > (GCodeDevice::getDevice ());
+
+	if (nullptr == device)
+	{
+		return;
+	}
+
+	auto const kind = static_cast< GrblOverride > (selected_override_);
+
+	switch (i_button)
+	{
+	default: {
+	}
+	break;
+
+	case Button::ENC_DOWN:
+		[[fallthrough]];
+	case Button::ENC_UP: {
+		if (GrblOverride::kRapid == kind)
+		{
+			// 25, 50, 100: one level per detent
+			auto const value = device->OverrideTarget (kind)
+			    ? device->OverrideTarget (kind)
+			    : device->OverrideValue (kind);
+
+			device->SetOverride (kind, i_arg > 0 ? value * 2 : value / 2);
+		}
+		else
+		{
+			device->AdjustOverride (
+			    kind, kStepValues[ selected_step_ ] * i_arg);
+		}
+
+		setDirty ();
+	}
+	break;
+
+	case Button::BT2: {
+		device->SetOverride (kind, kGrblOverrideDefault);
+
+		setDirty ();
+	}
+	break;
+	}
+}
+
+
+void OverrideControl::onPotValueChanged (
+    int i_potentiometer_index, int i_adc_value)
+{
+	auto const current_position = GetDiscretePotentiomenterPosition (
+	    kPotentiometersConfiguration[ i_potentiometer_index ], i_adc_value);
+
+	if (current_position < 0)
+	{
+		return;
+	}
+
+	auto& var =
+	    (0 == i_potentiometer_index) ? selected_override_ : selected_step_;
+
+	if (current_position != var)
+	{
+		var = current_position;
+
+		setDirty ();
+	}
+}
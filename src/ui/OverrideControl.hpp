@@ -0,0 +1,52 @@
+#ifndef SRC_UI_OVERRIDECONTROL_HPP
+#define SRC_UI_OVERRIDECONTROL_HPP
+
+
+#include <functional>
+
+#include <Arduino.h>
+
+#include <etl/vector.h>
+
+
+#include "../devices/GrblOverrides.hpp"
+#include "Screen.h"
+
+
+/*
+  Feed, rapid and spindle overrides of a Grbl machine. The left switch picks
+  the override, the right one the step, the encoder changes the selected
+  override and BT2 sets it back to 100%.
+*/
+class OverrideControl : public Screen, public DeviceObserver {
+public:
+	void SetReturnCallback (std::function< void () > i_return_callback);
+
+	void notification (const DeviceStatusEvent& i_event) override;
+
+
+protected:
+	void drawContents () override;
+
+	void onButtonPressed (Button i_button, int8_t i_arg) override;
+	void onPotValueChanged (int i_potentiometer_index, int i_value) override;
+
+
+private:
+	static size_t constexpr kStepCount = 3;
+
+	static inline etl::vector< uint8_t, kStepCount > const kStepValues = {
+	    1, 5, 10};
+
+	int selected_override_{0};
+	int selected_step_{2};
+
+	// Drawn values, to redraw only when they change
+	uint8_t shown_values_[ kGrblOverrideCount ]{};
+	uint8_t shown_targets_[ kGrblOverrideCount ]{};
+
+	std::function< void () > return_callback_;
+};
+
+
+#endif // SRC_UI_OVERRIDECONTROL_HPP
@@ -231,7 +231,7 @@ void SpindleControl::drawContents ()
 
 	const char* stat = device->isInPanic ()
 	    ? device->getLastResponse ().c_str ()
-	    : device->getStatus ().c_str ();
+	    : device->getStatus ();
 
 	u8g2.drawStr (0, kStatusLineY, stat);
 };
@@ -0,0 +1,278 @@
+#include "TemperatureGraph.hpp"
+
+
+#include <stdio.h>
+
+#include <etl/algorithm.h>
+#include <etl/utility.h>
+
+#include "../devices/GCodeDevice.h"
+
+#include "../font_info.hpp"
+
+
+namespace {
+	MarlinDevice* GetMarlinDevice ()
+	{
+		auto const device = GCodeDevice::getDevice ();
+
+		if ((nullptr == device) || (device->getType () != "marlin"))
+		{
+			return nullptr;
+		}
+
+		return static_cast< MarlinDevice* > (device);
+	}
+
+
+	/// The bed comes after the extruders
+	bool IsBed (const MarlinDevice& i_device, int i_heater)
+	{
+		return i_heater >= i_device.getExtruderCount ();
+	}
+} // namespace
+
+
+void TemperatureGraph::SetReturnCallback (
+    std::function< void () > i_return_callback)
+{
+	assert (bool (i_return_callback));
+
+	return_callback_ = etl::move (i_return_callback);
+}
+
+
+void TemperatureGraph::loop ()
+{
+	Refresh (false);
+}
+
+
+void TemperatureGraph::onShow ()
+{
+	Refresh (true);
+}
+
+
+void TemperatureGraph::Refresh (bool i_force)
+{
+	auto const device = GetMarlinDevice ();
+
+	if (nullptr == device)
+	{
+		return;
+	}
+
+	heater_ =
+	    etl::min (heater_, static_cast< int > (device->getExtruderCount ()));
+
+	auto const& history = IsBed (*device, heater_)
+	    ? device->getBedHistory ()
+	    : device->getExtruderHistory (heater_);
+
+	auto const count = history.Count (tier_);
+
+	if (!i_force && (count == shown_count_))
+	{
+		return;
+	}
+
+	shown_count_ = count;
+
+	etl::fill_n (lowest_, kColumns, kNoReading);
+	etl::fill_n (highest_, kColumns, kNoReading);
+	etl::fill_n (target_, kColumns, int16_t{0});
+
+	// The whole span is always shown, so a column keeps its time
+	auto const capacity = TemperatureHistory::Tier::kFine == tier_
+	    ? TemperatureHistory::kFineCount
+	    : TemperatureHistory::kCoarseCount;
+
+	for (size_t age = 0, size = history.Size (tier_); age < size; ++age)
+	{
+		auto const sample = history.Get (tier_, age);
+
+		if (sample.IsMissing ())
+		{
+			continue;
+		}
+
+		auto const column = kColumns - 1 - age * kColumns / capacity;
+
+		if (kNoReading == lowest_[ column ])
+		{
+			lowest_[ column ]  = sample.actual;
+			highest_[ column ] = sample.actual;
+			target_[ column ]  = sample.target;
+		}
+		else
+		{
+			lowest_[ column ]  = etl::min (lowest_[ column ], sample.actual);
+			highest_[ column ] = etl::max (highest_[ column ], sample.actual);
+		}
+	}
+
+	setDirty ();
+}
+
+
+void TemperatureGraph::drawContents ()
+{
+	static constexpr auto& kFont = u8g2_font_4x6_tr;
+
+	static auto const kLineHeight = ComputeLineHeight (kFont, Display::u8g2);
+
+	static auto constexpr kTopY = Display::STATUS_BAR_HEIGHT + 1;
+
+	static auto const kGraphTop = kTopY + 2 * kLineHeight + 1;
+
+	// The menu stays free
+	static auto const kGraphBottom = Display::u8g2.getHeight () - 10 - 2;
+
+	// At least 5 °C from the bottom to the top
+	static int16_t constexpr kMinRange = 50;
+
+
+	auto const device = GetMarlinDevice ();
+
+	if (nullptr == device)
+	{
+		return;
+	}
+
+	U8G2& u8g2 = Display::u8g2;
+
+	u8g2.setFont (kFont);
+	u8g2.setDrawColor (1);
+
+	char str[ 24 ]{};
+
+	auto const is_bed = IsBed (*device, heater_);
+
+	auto const& current = is_bed ? device->getBedTemp ()
+	                             : device->getExtruderTemp (heater_);
+
+	if (is_bed)
+	{
+		snprintf (str, sizeof (str), "Bed");
+	}
+	else
+	{
+		snprintf (str, sizeof (str), "T%d", heater_);
+	}
+
+	u8g2.drawStr (12, 0, str);
+
+	snprintf (str, sizeof (str), "%.1f/%.0f", current.actual, current.target);
+	u8g2.drawStr (0, kTopY, str);
+
+	int lowest  = INT16_MAX;
+	int highest = INT16_MIN;
+
+	for (int column = 0; column < kColumns; ++column)
+	{
+		if (kNoReading == lowest_[ column ])
+		{
+			continue;
+		}
+
+		lowest  = etl::min (lowest, int{lowest_[ column ]});
+		highest = etl::max (highest, int{highest_[ column ]});
+
+		if (0 != target_[ column ])
+		{
+			lowest  = etl::min (lowest, int{target_[ column ]});
+			highest = etl::max (highest, int{target_[ column ]});
+		}
+	}
+
+	auto const span =
+	    TemperatureHistory::Tier::kFine == tier_ ? "10m" : "1h";
+
+	if (lowest > highest)
+	{
+		snprintf (str, sizeof (str), "%s no readings", span);
+		u8g2.drawStr (0, kTopY + kLineHeight, str);
+
+		return;
+	}
+
+	if (highest - lowest < kMinRange)
+	{
+		lowest -= (kMinRange - (highest - lowest)) / 2;
+		highest = lowest + kMinRange;
+	}
+
+	snprintf (
+	    str, sizeof (str), "%s %d-%dC", span, lowest / 10, (highest + 9) / 10);
+	u8g2.drawStr (0, kTopY + kLineHeight, str);
+
+	auto const toY = [ lowest, highest ] (int i_tenths) {
+		return kGraphBottom -
+		    (i_tenths - lowest) * (kGraphBottom - kGraphTop) /
+		    (highest - lowest);
+	};
+
+	u8g2.drawFrame (0, kGraphTop - 1, kColumns, kGraphBottom - kGraphTop + 3);
+
+	for (int column = 0; column < kColumns; ++column)
+	{
+		if (kNoReading == lowest_[ column ])
+		{
+			continue;
+		}
+
+		auto const top = toY (highest_[ column ]);
+
+		u8g2.drawVLine (column, top, toY (lowest_[ column ]) - top + 1);
+
+		if ((0 != target_[ column ]) && (0 == column % 2))
+		{
+			u8g2.drawPixel (column, toY (target_[ column ]));
+		}
+	}
+}
+
+
+void TemperatureGraph::onButtonPressed (Button i_button, int8_t i_arg)
+{
+	switch (i_button)
+	{
+	default: {
+	}
+	break;
+
+	case Button::BT1: {
+		return_callback_ ();
+	}
+	break;
+
+	case Button::BT2: {
+		tier_ = TemperatureHistory::Tier::kFine == tier_
+		    ? TemperatureHistory::Tier::kCoarse
+		    : TemperatureHistory::Tier::kFine;
+
+		Refresh (true);
+	}
+	break;
+
+	case Button::ENC_DOWN:
+		[[fallthrough]];
+	case Button::ENC_UP: {
+		auto const device = GetMarlinDevice ();
+
+		if (nullptr == device)
+		{
+			return;
+		}
+
+		// Around the extruders and the bed
+		auto const heaters = device->getExtruderCount () + 1;
+
+		heater_ = ((heater_ - i_arg) % heaters + heaters) % heaters;
+
+		Refresh (true);
+	}
+	break;
+	}
+}
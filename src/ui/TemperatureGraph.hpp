@@ -0,0 +1,57 @@
+#ifndef SRC_UI_TEMPERATUREGRAPH_HPP
+#define SRC_UI_TEMPERATUREGRAPH_HPP
+
+
+#include <functional>
+
+#include <Arduino.h>
+
+
+#include "../devices/TemperatureHistory.hpp"
+#include "Screen.h"
+
+
+/*
+  Temperature history of a Marlin heater, the last 10 minutes or the last
+  hour, with the spread of the readings behind each pixel column and the
+  target dotted. The encoder picks the heater, BT2 switches the span, BT1
+  returns.
+*/
+class TemperatureGraph : public Screen {
+public:
+	void SetReturnCallback (std::function< void () > i_return_callback);
+
+	void loop () override;
+
+
+protected:
+	void drawContents () override;
+
+	void onButtonPressed (Button i_button, int8_t i_arg) override;
+
+	void onShow () override;
+
+
+private:
+	static int constexpr kColumns = 64; ///< The display width
+
+	static int16_t constexpr kNoReading = TemperatureSample::kMissing;
+
+	int16_t lowest_[ kColumns ]; ///< 0.1 °C, kNoReading for none
+	int16_t highest_[ kColumns ];
+	int16_t target_[ kColumns ]; ///< 0 with the heater off
+
+	int heater_{0}; ///< Extruders first, then the bed
+
+	TemperatureHistory::Tier tier_{TemperatureHistory::Tier::kFine};
+
+	uint32_t shown_count_{0}; ///< TemperatureHistory::Count () of the columns
+
+	std::function< void () > return_callback_;
+
+	/// Takes the columns from the history again if it changed
+	void Refresh (bool i_force);
+};
+
+
+#endif // SRC_UI_TEMPERATUREGRAPH_HPP
@@ -326,7 +326,7 @@ private:
 	{
 		assert (nullptr != o_device);
 
-		o_device->scheduleCommand ("G92.1");
+		o_device->scheduleModeCommand ("G92.1");
 
 		if ((kNoToolId == i_current_tool) || (i_prev_tool == i_current_tool))
 		{